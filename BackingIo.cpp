@@ -0,0 +1,223 @@
+#include <cstring>
+
+#include <unistd.h>
+#include <linux/io_uring.h>
+#include <sys/mman.h>
+#include <sys/syscall.h>
+
+#include "BackingIo.h"
+
+bool BackingIo::submit() {
+	bool ok = true;
+	unsigned aligned = 0;
+
+	// requests which would need bounce buffer are executed one by one
+	for (unsigned i = 0; i < m_queue.size(); ++i) {
+		st_io_request_t &req = m_queue[i];
+		if (isAligned(req.buf, req.count, req.offset)) {
+			m_queue[aligned++] = req;
+			continue;
+		}
+		if (E_IO_READ == req.op)
+			req.result = readAligned(req.fd, req.buf, req.count, req.offset);
+		else
+			req.result = writeAligned(req.fd, req.buf, req.count, req.offset);
+		ok &= (static_cast<ssize_t>(req.count) == req.result);
+		PROBE5(io_request, req.op, req.fd, req.offset, req.count, req.result);
+	}
+	if (0 != aligned) {
+		ok &= execute(m_queue.data(), aligned);
+		for (unsigned i = 0; i < aligned; ++i) {
+			ok &= (static_cast<ssize_t>(m_queue[i].count) == m_queue[i].result);
+			PROBE5(io_request, m_queue[i].op, m_queue[i].fd, m_queue[i].offset, m_queue[i].count, m_queue[i].result);
+		}
+	}
+	PROBE2(io_submit, m_queue.size(), ok);
+	m_queue.clear();
+	return (ok);
+}
+
+ssize_t BackingIo::readAligned(int fd, void *buf, size_t count, off_t offset) {
+	off_t head = offset & ~(m_alignment - 1);
+	size_t shift = offset - head;
+	size_t span = (shift + count + m_alignment - 1) & ~(m_alignment - 1);
+
+	if (!reserveBounce(span))
+		return (-1);
+	ssize_t ret = doRead(fd, m_bounce.get(), span, head);
+	if (ret < 0)
+		return (ret);
+	if (static_cast<size_t>(ret) <= shift)
+		return (0);
+	ret -= shift;
+	if (static_cast<size_t>(ret) > count)
+		ret = count;
+	memcpy(buf, &m_bounce[shift], ret);
+	return (ret);
+}
+
+ssize_t BackingIo::writeAligned(int fd, const void *buf, size_t count, off_t offset) {
+	off_t head = offset & ~(m_alignment - 1);
+	size_t shift = offset - head;
+	size_t span = (shift + count + m_alignment - 1) & ~(m_alignment - 1);
+
+	if (!reserveBounce(span))
+		return (-1);
+	if (static_cast<ssize_t>(span) != doRead(fd, m_bounce.get(), span, head))
+		return (-1);
+	memcpy(&m_bounce[shift], buf, count);
+	if (static_cast<ssize_t>(span) != doWrite(fd, m_bounce.get(), span, head))
+		return (-1);
+	return (count);
+}
+
+bool BackingIo::reserveBounce(const size_t size) {
+	if (size <= m_bounceSize)
+		return (true);
+	m_bounce.reset(allocAligned(size));
+	m_bounceSize = (m_bounce)?(size):(0);
+	return (0 != m_bounceSize);
+}
+
+BackingIoUring::BackingIoUring(SyscallsCache &syscallsCache)
+ : BackingIo(syscallsCache), m_sqRing(MAP_FAILED), m_cqRing(MAP_FAILED), m_sqes(static_cast<struct io_uring_sqe*>(MAP_FAILED)) {
+	struct io_uring_params params;
+	memset(&params, 0x00, sizeof(params));
+
+	m_ringFd = syscall(__NR_io_uring_setup, BACKING_IO_URING_ENTRIES, &params);
+	if (m_ringFd < 0)
+		return;
+
+	m_entries = params.sq_entries;
+	m_sqRingSize = params.sq_off.array + params.sq_entries * sizeof(unsigned);
+	m_cqRingSize = params.cq_off.cqes + params.cq_entries * sizeof(struct io_uring_cqe);
+	if (params.features & IORING_FEAT_SINGLE_MMAP) {
+		if (m_cqRingSize > m_sqRingSize)
+			m_sqRingSize = m_cqRingSize;
+		m_cqRingSize = m_sqRingSize;
+	}
+
+	m_sqRing = mmap(NULL, m_sqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQ_RING);
+	if (MAP_FAILED == m_sqRing)
+		return;
+	if (params.features & IORING_FEAT_SINGLE_MMAP)
+		m_cqRing = m_sqRing;
+	else
+		m_cqRing = mmap(NULL, m_cqRingSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_CQ_RING);
+	if (MAP_FAILED == m_cqRing)
+		return;
+	m_sqesSize = params.sq_entries * sizeof(struct io_uring_sqe);
+	m_sqes = static_cast<struct io_uring_sqe*>(mmap(NULL, m_sqesSize, PROT_READ | PROT_WRITE, MAP_SHARED | MAP_POPULATE, m_ringFd, IORING_OFF_SQES));
+	if (MAP_FAILED == m_sqes)
+		return;
+
+	char *sq = static_cast<char*>(m_sqRing);
+	char *cq = static_cast<char*>(m_cqRing);
+	m_sqTail = reinterpret_cast<unsigned*>(sq + params.sq_off.tail);
+	m_sqMask = reinterpret_cast<unsigned*>(sq + params.sq_off.ring_mask);
+	m_sqArray = reinterpret_cast<unsigned*>(sq + params.sq_off.array);
+	m_cqHead = reinterpret_cast<unsigned*>(cq + params.cq_off.head);
+	m_cqTail = reinterpret_cast<unsigned*>(cq + params.cq_off.tail);
+	m_cqMask = reinterpret_cast<unsigned*>(cq + params.cq_off.ring_mask);
+	m_cqes = reinterpret_cast<struct io_uring_cqe*>(cq + params.cq_off.cqes);
+
+	m_ok = true;
+}
+
+BackingIoUring::~BackingIoUring() {
+	if (MAP_FAILED != m_sqes)
+		munmap(m_sqes, m_sqesSize);
+	if ((MAP_FAILED != m_cqRing) && (m_cqRing != m_sqRing))
+		munmap(m_cqRing, m_cqRingSize);
+	if (MAP_FAILED != m_sqRing)
+		munmap(m_sqRing, m_sqRingSize);
+	if (m_ringFd >= 0)
+		m_syscallsCache.invokeClose(m_ringFd);
+}
+
+ssize_t BackingIoUring::doRead(int fd, void *buf, size_t count, off_t offset) {
+	st_io_request_t req = {E_IO_READ, fd, buf, count, offset, 0};
+	if (!execute(&req, 1))
+		return (-1);
+	return (req.result);
+}
+
+ssize_t BackingIoUring::doWrite(int fd, const void *buf, size_t count, off_t offset) {
+	st_io_request_t req = {E_IO_WRITE, fd, const_cast<void*>(buf), count, offset, 0};
+	if (!execute(&req, 1))
+		return (-1);
+	return (req.result);
+}
+
+void BackingIoUring::registerBuffers(const struct iovec *iov, unsigned count) {
+	if (0 != m_fixedBuffers.size())
+		syscall(__NR_io_uring_register, m_ringFd, IORING_UNREGISTER_BUFFERS, NULL, 0);
+	m_fixedBuffers.clear();
+	if (0 > syscall(__NR_io_uring_register, m_ringFd, IORING_REGISTER_BUFFERS, iov, count))
+		return;
+	m_fixedBuffers.assign(iov, iov + count);
+}
+
+int BackingIoUring::findFixedBuffer(const void *buf, size_t count) {
+	const char *head = static_cast<const char*>(buf);
+	for (unsigned i = 0; i < m_fixedBuffers.size(); ++i) {
+		const char *base = static_cast<const char*>(m_fixedBuffers[i].iov_base);
+		if ((head >= base) && (head + count <= base + m_fixedBuffers[i].iov_len))
+			return (i);
+	}
+	return (-1);
+}
+
+bool BackingIoUring::execute(st_io_request_t *reqs, unsigned count) {
+	for (unsigned done = 0; done < count;) {
+		unsigned chunk = ((count - done) < m_entries)?(count - done):(m_entries);
+		unsigned tail = *m_sqTail;
+
+		for (unsigned i = 0; i < chunk; ++i) {
+			st_io_request_t &req = reqs[done + i];
+			unsigned idx = tail & *m_sqMask;
+			struct io_uring_sqe *sqe = &m_sqes[idx];
+			int buf_index = findFixedBuffer(req.buf, req.count);
+
+			memset(sqe, 0x00, sizeof(*sqe));
+			if (buf_index < 0) {
+				sqe->opcode = (E_IO_READ == req.op)?(IORING_OP_READ):(IORING_OP_WRITE);
+			} else {
+				sqe->opcode = (E_IO_READ == req.op)?(IORING_OP_READ_FIXED):(IORING_OP_WRITE_FIXED);
+				sqe->buf_index = buf_index;
+			}
+			sqe->fd = req.fd;
+			sqe->addr = reinterpret_cast<unsigned long>(req.buf);
+			sqe->len = req.count;
+			sqe->off = req.offset;
+			sqe->user_data = done + i;
+			m_sqArray[idx] = idx;
+			++tail;
+		}
+		__atomic_store_n(m_sqTail, tail, __ATOMIC_RELEASE);
+
+		unsigned submitted = 0;
+		unsigned reaped = 0;
+		while (reaped < chunk) {
+			int ret = syscall(__NR_io_uring_enter, m_ringFd, chunk - submitted, chunk - reaped, IORING_ENTER_GETEVENTS, NULL, 0);
+			if (ret < 0) {
+				if (EINTR == errno)
+					continue;
+				return (false);
+			}
+			submitted += ret;
+			unsigned head = *m_cqHead;
+			while (head != __atomic_load_n(m_cqTail, __ATOMIC_ACQUIRE)) {
+				struct io_uring_cqe *cqe = &m_cqes[head & *m_cqMask];
+				reqs[cqe->user_data].result = cqe->res;
+				if (cqe->res < 0)
+					errno = -cqe->res;
+				++head;
+				++reaped;
+			}
+			__atomic_store_n(m_cqHead, head, __ATOMIC_RELEASE);
+		}
+		done += chunk;
+	}
+	return (true);
+}
@@ -0,0 +1,190 @@
+#ifndef __BACKINGIO_H__
+#define __BACKINGIO_H__
+
+#define BACKING_IO_URING_ENTRIES 64
+#define DIRECT_IO_ALIGNMENT      4096
+
+#include <cstdint>
+#include <cstdlib>
+#include <memory>
+#include <vector>
+
+#include <sys/types.h>
+#include <sys/uio.h>
+
+#include "Probes.h"
+#include "SyscallsCache.h"
+
+enum e_io_op_t {
+	E_IO_READ = 0,
+	E_IO_WRITE
+};
+
+struct st_io_request_t {
+	e_io_op_t op;
+	int fd;
+	void *buf;
+	size_t count;
+	off_t offset;
+	ssize_t result;
+};
+
+struct AlignedDeleter {
+	void operator()(char *ptr) { free(ptr); }
+};
+
+typedef std::unique_ptr<char[], AlignedDeleter> aligned_buffer_t;
+
+// buffers usable for O_DIRECT transfers, returns NULL on failure
+static inline char* allocAligned(const size_t size) {
+	void *ptr;
+	if (0 != posix_memalign(&ptr, DIRECT_IO_ALIGNMENT, size))
+		return (NULL);
+	return (static_cast<char*>(ptr));
+}
+
+// Cache file I/O backend, single operations are executed immediately,
+// queued ones are executed together by submit(). When alignment is set
+// (O_DIRECT) unaligned requests go through bounce buffer (read-modify-write).
+class BackingIo {
+public:
+	virtual ~BackingIo() {}
+
+	virtual bool isOk() = 0;
+	virtual const char* getName() = 0;
+
+	void setAlignment(const size_t alignment) { m_alignment = alignment; }
+
+	ssize_t read(int fd, void *buf, size_t count, off_t offset) {
+		ssize_t ret = (isAligned(buf, count, offset))?(doRead(fd, buf, count, offset)):(readAligned(fd, buf, count, offset));
+		PROBE4(io_read, fd, offset, count, ret);
+		return (ret);
+	}
+	ssize_t write(int fd, const void *buf, size_t count, off_t offset) {
+		ssize_t ret = (isAligned(buf, count, offset))?(doWrite(fd, buf, count, offset)):(writeAligned(fd, buf, count, offset));
+		PROBE4(io_write, fd, offset, count, ret);
+		return (ret);
+	}
+
+	// buffers which will be used for I/O repeatedly (page buffer, block cache)
+	virtual void registerBuffers(const struct iovec *iov, unsigned count) { (void)iov; (void)count; }
+
+	void queueRead(int fd, void *buf, size_t count, off_t offset) {
+		m_queue.push_back({E_IO_READ, fd, buf, count, offset, 0});
+	}
+	void queueWrite(int fd, const void *buf, size_t count, off_t offset) {
+		m_queue.push_back({E_IO_WRITE, fd, const_cast<void*>(buf), count, offset, 0});
+	}
+
+	// returns true if all queued requests were fully completed
+	bool submit();
+
+protected:
+	BackingIo(SyscallsCache &syscallsCache)
+	 : m_syscallsCache(syscallsCache) {}
+
+	virtual ssize_t doRead(int fd, void *buf, size_t count, off_t offset) = 0;
+	virtual ssize_t doWrite(int fd, const void *buf, size_t count, off_t offset) = 0;
+	virtual bool execute(st_io_request_t *reqs, unsigned count) = 0;
+
+	std::vector<st_io_request_t> m_queue;
+	SyscallsCache &m_syscallsCache;
+
+private:
+	bool isAligned(const void *buf, size_t count, off_t offset) {
+		if (m_alignment <= 1)
+			return (true);
+		return (0 == ((reinterpret_cast<uintptr_t>(buf) | count | offset) & (m_alignment - 1)));
+	}
+
+	ssize_t readAligned(int fd, void *buf, size_t count, off_t offset);
+	ssize_t writeAligned(int fd, const void *buf, size_t count, off_t offset);
+	bool reserveBounce(const size_t size);
+
+	size_t m_alignment = 0;
+	aligned_buffer_t m_bounce;
+	size_t m_bounceSize = 0;
+};
+
+class BackingIoSync : public BackingIo {
+	friend class BackingIoFactory;
+
+public:
+	~BackingIoSync() {}
+
+	bool isOk() { return (true); }
+	const char* getName() { return ("sync"); }
+
+private:
+	BackingIoSync(SyscallsCache &syscallsCache)
+	 : BackingIo(syscallsCache) {}
+
+	ssize_t doRead(int fd, void *buf, size_t count, off_t offset)
+		{ return (m_syscallsCache.invokePread(fd, buf, count, offset)); }
+	ssize_t doWrite(int fd, const void *buf, size_t count, off_t offset)
+		{ return (m_syscallsCache.invokePwrite(fd, buf, count, offset)); }
+
+	bool execute(st_io_request_t *reqs, unsigned count) {
+		for (unsigned i = 0; i < count; ++i) {
+			if (E_IO_READ == reqs[i].op)
+				reqs[i].result = doRead(reqs[i].fd, reqs[i].buf, reqs[i].count, reqs[i].offset);
+			else
+				reqs[i].result = doWrite(reqs[i].fd, reqs[i].buf, reqs[i].count, reqs[i].offset);
+		}
+		return (true);
+	}
+};
+
+class BackingIoUring : public BackingIo {
+	friend class BackingIoFactory;
+
+public:
+	~BackingIoUring();
+
+	bool isOk() { return (m_ok); }
+	const char* getName() { return ("io_uring"); }
+
+	void registerBuffers(const struct iovec *iov, unsigned count);
+
+private:
+	BackingIoUring(SyscallsCache &syscallsCache);
+
+	ssize_t doRead(int fd, void *buf, size_t count, off_t offset);
+	ssize_t doWrite(int fd, const void *buf, size_t count, off_t offset);
+
+	bool execute(st_io_request_t *reqs, unsigned count);
+	int findFixedBuffer(const void *buf, size_t count);
+
+	bool m_ok = false;
+	int m_ringFd;
+
+	void *m_sqRing;
+	void *m_cqRing;
+	size_t m_sqRingSize;
+	size_t m_cqRingSize;
+	struct io_uring_sqe *m_sqes;
+	size_t m_sqesSize;
+
+	unsigned *m_sqTail;
+	unsigned *m_sqMask;
+	unsigned *m_sqArray;
+	unsigned *m_cqHead;
+	unsigned *m_cqTail;
+	unsigned *m_cqMask;
+	struct io_uring_cqe *m_cqes;
+	unsigned m_entries;
+
+	std::vector<struct iovec> m_fixedBuffers;
+};
+
+class BackingIoFactory {
+public:
+	static BackingIo* createBackingIoSync(SyscallsCache &syscallsCache) {
+		return (new BackingIoSync(syscallsCache));
+	}
+	static BackingIo* createBackingIoUring(SyscallsCache &syscallsCache) {
+		return (new BackingIoUring(syscallsCache));
+	}
+};
+
+#endif // __BACKINGIO_H__
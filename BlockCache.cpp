@@ -0,0 +1,120 @@
+#include <cstring>
+#include <stdexcept>
+
+#include "BlockCache.h"
+#include "Libnorsim.h"
+#include "Logger.h"
+
+BlockCache::BlockCache(Libnorsim &libnorsim, const unsigned pageCount, const unsigned capacity)
+ : m_capacity(capacity), m_hand(0), m_blockSize(libnorsim.getEraseSize()),
+   m_slots(pageCount, BLOCK_CACHE_SLOT_NONE), m_geometry(libnorsim.getGeometry()), m_libnorsim(libnorsim) {
+	m_data.reset(allocAligned(m_blockSize * m_capacity));
+	m_entries.reset(new st_cache_entry_t[m_capacity]);
+	if ((!m_data) || (!m_entries))
+		throw std::runtime_error("Couldn't allocate memory for block cache");
+	memset(m_entries.get(), 0x00, sizeof(st_cache_entry_t) * m_capacity);
+	memset(&m_stats, 0x00, sizeof(m_stats));
+	m_libnorsim.getLogger().log(Loglevel::INFO, "Set block cache: %u blocks (%lukB)", false,
+		m_capacity, (m_blockSize * m_capacity) / 1024);
+}
+
+BlockCache::~BlockCache() {
+	flush();
+}
+
+char* BlockCache::acquire(const unsigned index, const bool load) {
+	unsigned slot = m_slots[index];
+	if (BLOCK_CACHE_SLOT_NONE != slot) {
+		m_entries[slot].referenced = true;
+		m_stats.hits++;
+		return (getSlotData(slot));
+	}
+
+	m_stats.misses++;
+	if (BLOCK_CACHE_SLOT_NONE == (slot = reclaimSlot()))
+		return (NULL);
+
+	char *data = getSlotData(slot);
+	if (load) {
+		unsigned long size = m_geometry.getBlockSize(index);
+		if (size != static_cast<unsigned long>(m_libnorsim.getBackingIo().read(m_libnorsim.getBackingFd(), data, size, m_geometry.getBlockOffset(index)))) {
+			m_libnorsim.getLogger().log(Loglevel::WARNING, "Block cache: couldn't load page: %u", false, index);
+			return (NULL);
+		}
+	}
+	m_entries[slot].index = index;
+	m_entries[slot].valid = true;
+	m_entries[slot].dirty = false;
+	m_entries[slot].referenced = true;
+	m_slots[index] = slot;
+	return (data);
+}
+
+void BlockCache::setDirty(const unsigned index) {
+	m_entries[m_slots[index]].dirty = true;
+}
+
+bool BlockCache::flush() {
+	BackingIo &io = m_libnorsim.getBackingIo();
+	unsigned long writebacks = 0;
+	for (unsigned slot = 0; slot < m_capacity; ++slot) {
+		if (m_entries[slot].valid && m_entries[slot].dirty) {
+			unsigned index = m_entries[slot].index;
+			io.queueWrite(m_libnorsim.getBackingFd(), getSlotData(slot), m_geometry.getBlockSize(index), m_geometry.getBlockOffset(index));
+			++writebacks;
+		}
+	}
+	if (0 == writebacks)
+		return (true);
+	if (!io.submit()) {
+		m_libnorsim.getLogger().log(Loglevel::ERROR, "Block cache: couldn't write back %lu pages", false, writebacks);
+		return (false);
+	}
+	for (unsigned slot = 0; slot < m_capacity; ++slot)
+		m_entries[slot].dirty = false;
+	m_stats.writebacks += writebacks;
+	return (true);
+}
+
+bool BlockCache::invalidate() {
+	bool ret = flush();
+	for (unsigned slot = 0; slot < m_capacity; ++slot) {
+		if (m_entries[slot].valid)
+			m_slots[m_entries[slot].index] = BLOCK_CACHE_SLOT_NONE;
+		m_entries[slot].valid = false;
+		m_entries[slot].dirty = false;
+	}
+	return (ret);
+}
+
+unsigned BlockCache::reclaimSlot() {
+	for (;;) {
+		st_cache_entry_t &entry = m_entries[m_hand];
+		unsigned slot = m_hand;
+		m_hand = (m_hand + 1) % m_capacity;
+
+		if (!entry.valid)
+			return (slot);
+		if (entry.referenced) {
+			entry.referenced = false;
+			continue;
+		}
+		if (entry.dirty && !writeBack(slot))
+			return (BLOCK_CACHE_SLOT_NONE);
+		m_slots[entry.index] = BLOCK_CACHE_SLOT_NONE;
+		entry.valid = false;
+		return (slot);
+	}
+}
+
+bool BlockCache::writeBack(const unsigned slot) {
+	unsigned index = m_entries[slot].index;
+	unsigned long size = m_geometry.getBlockSize(index);
+	if (size != static_cast<unsigned long>(m_libnorsim.getBackingIo().write(m_libnorsim.getBackingFd(), getSlotData(slot), size, m_geometry.getBlockOffset(index)))) {
+		m_libnorsim.getLogger().log(Loglevel::ERROR, "Block cache: couldn't write back page: %u", false, index);
+		return (false);
+	}
+	m_entries[slot].dirty = false;
+	m_stats.writebacks++;
+	return (true);
+}
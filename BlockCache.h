@@ -0,0 +1,69 @@
+#ifndef __BLOCKCACHE_H__
+#define __BLOCKCACHE_H__
+
+#define BLOCK_CACHE_SLOT_NONE (~0u)
+#define BLOCK_CACHE_BATCH     16
+
+#include <memory>
+#include <vector>
+
+#include "BackingIo.h"
+#include "NorGeometry.h"
+
+struct st_cache_entry_t {
+	unsigned index;
+	bool valid;
+	bool dirty;
+	bool referenced;
+};
+
+struct st_cache_stats_t {
+	unsigned long hits;
+	unsigned long misses;
+	unsigned long writebacks;
+};
+
+class Libnorsim;
+
+// Write-back cache of whole eraseblocks kept in front of cache file I/O,
+// slots are reclaimed with CLOCK (second chance) algorithm; slots have size
+// of largest eraseblock
+class BlockCache {
+public:
+	BlockCache(Libnorsim &libnorsim, const unsigned pageCount, const unsigned capacity);
+	~BlockCache();
+
+	unsigned getCapacity() { return (m_capacity); }
+	const st_cache_stats_t& getStats() { return (m_stats); }
+	char* getData() { return (m_data.get()); }
+	unsigned long getDataSize() { return (m_blockSize * m_capacity); }
+
+	// returns cached copy of eraseblock, contents are read from cache file
+	// only when "load" is set (not needed if whole block will be overwritten)
+	char* acquire(const unsigned index, const bool load = true);
+	void setDirty(const unsigned index);
+
+	bool flush();
+	// written back and dropped, cache file may be changed directly afterwards
+	bool invalidate();
+
+private:
+	unsigned reclaimSlot();
+	bool writeBack(const unsigned slot);
+	char* getSlotData(const unsigned slot) { return (&m_data.get()[static_cast<unsigned long>(slot) * m_blockSize]); }
+
+	unsigned m_capacity;
+	unsigned m_hand;
+	unsigned long m_blockSize;
+
+	aligned_buffer_t m_data;
+	std::unique_ptr<st_cache_entry_t[]> m_entries;
+	std::vector<unsigned> m_slots;
+	NorGeometry &m_geometry;
+
+	st_cache_stats_t m_stats;
+
+	Libnorsim &m_libnorsim;
+};
+
+#endif // __BLOCKCACHE_H__
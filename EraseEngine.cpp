@@ -0,0 +1,115 @@
+#include <cerrno>
+#include <cstring>
+
+#include "EraseEngine.h"
+#include "Libnorsim.h"
+#include "Logger.h"
+
+EraseEngine::EraseEngine(Libnorsim &libnorsim, const unsigned pageCount, const e_erase_busy_t busyMode,
+	const unsigned long eraseTimeUs, const unsigned long suspendUs)
+ : m_busy(pageCount, false), m_pending(0), m_busyMode(busyMode), m_eraseTime(eraseTimeUs), m_suspendTime(suspendUs),
+   m_erasing(false), m_stop(false), m_libnorsim(libnorsim) {
+	memset(&m_stats, 0x00, sizeof(m_stats));
+	m_worker = std::thread(&EraseEngine::workerMain, this);
+}
+
+// erases still queued are finished without waiting erase time
+EraseEngine::~EraseEngine() {
+	{
+		std::lock_guard<std::mutex> lg(m_workerMutex);
+		m_stop = true;
+	}
+	m_workerCond.notify_one();
+	m_worker.join();
+}
+
+bool EraseEngine::access(const unsigned index) {
+	if (m_busy[index]) {
+		if (E_ERASE_BUSY_EBUSY == m_busyMode) {
+			m_stats.rejected++;
+			errno = EBUSY;
+			return (false);
+		}
+		m_stats.waits++;
+		// global mutex is owned by caller, it's only released for time of waiting
+		std::unique_lock<std::mutex> lock(m_libnorsim.getGlobalMutex(), std::adopt_lock);
+		m_doneCond.wait(lock, [this, index]() { return (!m_busy[index]); });
+		lock.release();
+		return (true);
+	}
+
+	if (0 == m_suspendTime.count())
+		return (true);
+	bool suspended = false;
+	{
+		std::lock_guard<std::mutex> lg(m_workerMutex);
+		if (m_erasing) {
+			m_deadline += m_suspendTime;
+			suspended = true;
+		}
+	}
+	if (suspended) {
+		m_stats.suspends++;
+		// other blocks stay available meanwhile, global mutex is released for suspend latency
+		std::unique_lock<std::mutex> lock(m_libnorsim.getGlobalMutex(), std::adopt_lock);
+		lock.unlock();
+		std::this_thread::sleep_for(m_suspendTime);
+		lock.lock();
+		lock.release();
+		// block could have been queued for erase meanwhile
+		if (m_busy[index])
+			return (access(index));
+	}
+	return (true);
+}
+
+void EraseEngine::queue(const unsigned first, const unsigned count, erase_handler_t handler, const std::chrono::nanoseconds duration) {
+	for (unsigned index = first; index < first + count; ++index)
+		m_busy[index] = true;
+	m_pending++;
+	m_stats.queued++;
+	{
+		std::lock_guard<std::mutex> lg(m_workerMutex);
+		m_jobs.push_back({first, count, handler, duration});
+	}
+	m_workerCond.notify_one();
+}
+
+void EraseEngine::drain() {
+	if (0 == m_pending)
+		return;
+	std::unique_lock<std::mutex> lock(m_libnorsim.getGlobalMutex(), std::adopt_lock);
+	m_doneCond.wait(lock, [this]() { return (0 == m_pending); });
+	lock.release();
+}
+
+// erase time is waited without global mutex, deadline can be moved by suspends meanwhile
+void EraseEngine::workerMain() {
+	std::unique_lock<std::mutex> lock(m_workerMutex);
+	for (;;) {
+		m_workerCond.wait(lock, [this]() { return (m_stop || !m_jobs.empty()); });
+		if (m_jobs.empty())
+			break;
+		st_erase_job_t job = m_jobs.front();
+		m_jobs.pop_front();
+
+		m_erasing = true;
+		m_deadline = std::chrono::steady_clock::now() + job.duration;
+		while (!m_stop && (std::chrono::steady_clock::now() < m_deadline))
+			m_workerCond.wait_until(lock, m_deadline);
+		m_erasing = false;
+		lock.unlock();
+
+		{
+			std::lock_guard<std::mutex> lg(m_libnorsim.getGlobalMutex());
+			if (0 != job.handler(m_libnorsim, job.first, job.count))
+				m_libnorsim.getLogger().log(Loglevel::NOTE, "Erase of pages %u-%u failed", false, job.first, job.first + job.count - 1);
+			for (unsigned index = job.first; index < job.first + job.count; ++index)
+				m_busy[index] = false;
+			m_pending--;
+			m_stats.completed++;
+			m_doneCond.notify_all();
+		}
+		lock.lock();
+	}
+}
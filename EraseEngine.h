@@ -0,0 +1,83 @@
+#ifndef __ERASEENGINE_H__
+#define __ERASEENGINE_H__
+
+#include <chrono>
+#include <condition_variable>
+#include <cstdint>
+#include <deque>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+enum e_erase_busy_t {
+	E_ERASE_BUSY_BLOCK = 0,
+	E_ERASE_BUSY_EBUSY
+};
+
+struct st_erase_stats_t {
+	unsigned long queued;
+	unsigned long completed;
+	unsigned long waits;
+	unsigned long rejected;
+	unsigned long suspends;
+};
+
+class Libnorsim;
+
+// performs erase of given blocks, called by worker with global mutex held
+typedef int (*erase_handler_t)(Libnorsim &libnorsim, const unsigned first, const unsigned count);
+
+struct st_erase_job_t {
+	unsigned first;
+	unsigned count;
+	erase_handler_t handler;
+	std::chrono::nanoseconds duration;
+};
+
+// Asynchronous erase: MEMERASE queues blocks to worker which waits erase time
+// (per block, or given by timing model) and performs erase afterwards. Access to block queued for erase
+// waits for its completion or fails with EBUSY, other blocks stay available.
+// With suspend latency set, access to other block during erase suspends it,
+// access pays the latency and erase is prolonged by it.
+class EraseEngine {
+public:
+	EraseEngine(Libnorsim &libnorsim, const unsigned pageCount, const e_erase_busy_t busyMode,
+		const unsigned long eraseTimeUs, const unsigned long suspendUs);
+	~EraseEngine();
+
+	e_erase_busy_t getBusyMode() { return (m_busyMode); }
+	const st_erase_stats_t& getStats() { return (m_stats); }
+	std::chrono::nanoseconds getEraseTime(const unsigned count) { return (m_eraseTime * count); }
+
+	// following are called with global mutex held
+
+	// true when block can be accessed, false (errno set to EBUSY) when it's being erased
+	// in EBUSY mode, in block mode global mutex is released while waiting (and for erase suspend latency)
+	bool access(const unsigned index);
+	void queue(const unsigned first, const unsigned count, erase_handler_t handler, const std::chrono::nanoseconds duration);
+	// waits (releasing global mutex) for all queued erases
+	void drain();
+
+private:
+	void workerMain();
+
+	std::vector<bool> m_busy;
+	unsigned long m_pending;
+	e_erase_busy_t m_busyMode;
+	std::chrono::microseconds m_eraseTime;
+	std::chrono::microseconds m_suspendTime;
+	st_erase_stats_t m_stats;
+	std::condition_variable m_doneCond;
+
+	std::deque<st_erase_job_t> m_jobs;
+	bool m_erasing;
+	std::chrono::steady_clock::time_point m_deadline;
+	std::thread m_worker;
+	std::mutex m_workerMutex;
+	std::condition_variable m_workerCond;
+	bool m_stop;
+
+	Libnorsim &m_libnorsim;
+};
+
+#endif // __ERASEENGINE_H__
@@ -0,0 +1,97 @@
+#ifndef __HISTOGRAM_H__
+#define __HISTOGRAM_H__
+
+// Log-linear histogram: values below 2^HISTOGRAM_SUB_BITS are counted exactly,
+// above every power of two is split into 2^HISTOGRAM_SUB_BITS linear buckets
+// (relative error below 1/2^HISTOGRAM_SUB_BITS), recording is O(1) and
+// allocation free.
+
+#define HISTOGRAM_SUB_BITS 4
+#define HISTOGRAM_SUB_COUNT (1 << HISTOGRAM_SUB_BITS)
+#define HISTOGRAM_BUCKETS ((64 - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT)
+
+#include <cstdint>
+#include <cstring>
+
+class Histogram {
+public:
+	Histogram() { reset(); }
+
+	void reset() {
+		memset(m_buckets, 0x00, sizeof(m_buckets));
+		m_count = 0;
+		m_sum = 0;
+		m_min = UINT64_MAX;
+		m_max = 0;
+	}
+
+	void record(const uint64_t value) {
+		m_buckets[getBucket(value)]++;
+		m_count++;
+		m_sum += value;
+		if (value < m_min)
+			m_min = value;
+		if (value > m_max)
+			m_max = value;
+	}
+
+	void merge(const Histogram &other) {
+		for (unsigned i = 0; i < HISTOGRAM_BUCKETS; ++i)
+			m_buckets[i] += other.m_buckets[i];
+		m_count += other.m_count;
+		m_sum += other.m_sum;
+		if (other.m_min < m_min)
+			m_min = other.m_min;
+		if (other.m_max > m_max)
+			m_max = other.m_max;
+	}
+
+	uint64_t getCount() const { return (m_count); }
+	uint64_t getMin() const { return ((m_count)?(m_min):(0)); }
+	uint64_t getMax() const { return (m_max); }
+	double getMean() const { return ((m_count)?(static_cast<double>(m_sum) / m_count):(0.0)); }
+
+	// upper bound of bucket holding given percentile (0.0 - 100.0), clamped to max
+	uint64_t getPercentile(const double percentile) const {
+		if (0 == m_count)
+			return (0);
+		uint64_t rank = static_cast<uint64_t>(percentile / 100.0 * m_count + 0.5);
+		if (0 == rank)
+			rank = 1;
+		uint64_t seen = 0;
+		for (unsigned i = 0; i < HISTOGRAM_BUCKETS; ++i) {
+			seen += m_buckets[i];
+			if (seen >= rank) {
+				uint64_t value = getBucketHigh(i);
+				return ((value > m_max)?(m_max):(value));
+			}
+		}
+		return (m_max);
+	}
+
+private:
+	static unsigned getBucket(const uint64_t value) {
+		if (value < HISTOGRAM_SUB_COUNT)
+			return (value);
+		unsigned exp = 63 - __builtin_clzll(value);
+		unsigned sub = (value >> (exp - HISTOGRAM_SUB_BITS)) & (HISTOGRAM_SUB_COUNT - 1);
+		return ((exp - HISTOGRAM_SUB_BITS + 1) * HISTOGRAM_SUB_COUNT + sub);
+	}
+
+	static uint64_t getBucketHigh(const unsigned bucket) {
+		if (bucket < HISTOGRAM_SUB_COUNT)
+			return (bucket);
+		unsigned exp = bucket / HISTOGRAM_SUB_COUNT + HISTOGRAM_SUB_BITS - 1;
+		uint64_t sub = bucket % HISTOGRAM_SUB_COUNT;
+		uint64_t width = 1ULL << (exp - HISTOGRAM_SUB_BITS);
+		return (((HISTOGRAM_SUB_COUNT + sub) << (exp - HISTOGRAM_SUB_BITS)) + width - 1);
+	}
+
+	uint64_t m_buckets[HISTOGRAM_BUCKETS];
+	uint64_t m_count;
+	uint64_t m_sum;
+	uint64_t m_min;
+	uint64_t m_max;
+};
+
+#endif // __HISTOGRAM_H__
@@ -0,0 +1,33 @@
+#include "LatencyStats.h"
+#include "Libnorsim.h"
+#include "Logger.h"
+
+static const char * const op_names[E_LAT_OP_COUNT] = {
+	"open", "close", "pread", "pwrite", "MEMGETINFO", "MEMUNLOCK", "MEMERASE", "bulk copy", "fsync", "batch", "passthrough"
+};
+
+static const char * const phase_names[E_LAT_PHASE_COUNT] = {
+	"lock wait", "backing I/O", "merge", "fault"
+};
+
+LatencyStats::LatencyStats(Libnorsim &libnorsim)
+ : m_libnorsim(libnorsim) {
+	m_libnorsim.getLogger().log(Loglevel::INFO, "Set latency statistics");
+}
+
+void LatencyStats::print() {
+	m_libnorsim.getLogger().log(Loglevel::ALWAYS, "\tLATENCY of operations [ns]:");
+	for (unsigned i = 0; i < E_LAT_OP_COUNT; ++i)
+		printHistogram(op_names[i], m_ops[i]);
+	m_libnorsim.getLogger().log(Loglevel::ALWAYS, "\tLATENCY of phases [ns]:");
+	for (unsigned i = 0; i < E_LAT_PHASE_COUNT; ++i)
+		printHistogram(phase_names[i], m_phases[i]);
+}
+
+void LatencyStats::printHistogram(const char *name, const Histogram &histogram) {
+	if (0 == histogram.getCount())
+		return;
+	m_libnorsim.getLogger().log(Loglevel::ALWAYS, "\t\t%-12s count=%lu, mean=%.0f, p50=%lu, p90=%lu, p99=%lu, p99.9=%lu, max=%lu", false,
+		name, histogram.getCount(), histogram.getMean(), histogram.getPercentile(50.0), histogram.getPercentile(90.0),
+		histogram.getPercentile(99.0), histogram.getPercentile(99.9), histogram.getMax());
+}
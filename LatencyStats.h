@@ -0,0 +1,76 @@
+#ifndef __LATENCYSTATS_H__
+#define __LATENCYSTATS_H__
+
+#include <cstdint>
+#include <ctime>
+
+#include "Histogram.h"
+
+enum e_lat_op_t {
+	E_LAT_OP_OPEN = 0,
+	E_LAT_OP_CLOSE,
+	E_LAT_OP_PREAD,
+	E_LAT_OP_PWRITE,
+	E_LAT_OP_GETINFO,
+	E_LAT_OP_UNLOCK,
+	E_LAT_OP_ERASE,
+	E_LAT_OP_BULK,
+	E_LAT_OP_SYNC,
+	E_LAT_OP_BATCH,
+	E_LAT_OP_PASSTHROUGH,
+	E_LAT_OP_COUNT
+};
+
+enum e_lat_phase_t {
+	E_LAT_PHASE_LOCK = 0,
+	E_LAT_PHASE_IO,
+	E_LAT_PHASE_MERGE,
+	E_LAT_PHASE_FAULT,
+	E_LAT_PHASE_COUNT
+};
+
+class Libnorsim;
+
+// Latency histograms of intercepted calls and of their phases (in ns),
+// recorded with global mutex held
+class LatencyStats {
+public:
+	LatencyStats(Libnorsim &libnorsim);
+
+	static uint64_t now() {
+		struct timespec ts;
+		clock_gettime(CLOCK_MONOTONIC, &ts);
+		return (ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+	}
+
+	void recordOp(const e_lat_op_t op, const uint64_t start) { m_ops[op].record(now() - start); }
+	void recordPhase(const e_lat_phase_t phase, const uint64_t start) { m_phases[phase].record(now() - start); }
+
+	void print();
+
+private:
+	void printHistogram(const char *name, const Histogram &histogram);
+
+	Histogram m_ops[E_LAT_OP_COUNT];
+	Histogram m_phases[E_LAT_PHASE_COUNT];
+
+	Libnorsim &m_libnorsim;
+};
+
+// records time spent in scope as given phase, when latency statistics are enabled
+class PhaseTimer {
+public:
+	PhaseTimer(LatencyStats *stats, const e_lat_phase_t phase)
+	 : m_stats(stats), m_phase(phase), m_start((NULL != m_stats)?(LatencyStats::now()):(0)) {}
+	~PhaseTimer() {
+		if (NULL != m_stats)
+			m_stats->recordPhase(m_phase, m_start);
+	}
+
+private:
+	LatencyStats *m_stats;
+	e_lat_phase_t m_phase;
+	uint64_t m_start;
+};
+
+#endif // __LATENCYSTATS_H__
@@ -4,8 +4,10 @@
 // implement read, write (any others?)
 // refactoring
 
+#include <cctype>
 #include <cstdio>
 #include <cstring>
+#include <string>
 
 #include <signal.h>
 #include <unistd.h>
@@ -16,10 +18,11 @@
 #include "Libnorsim.h"
 #include "LogFormatterLibnorsim.h"
 
-#define STATS_FILL(t,a,op) t.a##_##op = get_##a(t.a##_##op,m_pageManager->getPage(i).op)
+#define STATS_FILL(t,a,op) t.a##_##op = get_##a(t.a##_##op,getPageManager().getPage(i).op)
 
 extern "C" void sig_handler(int signum);
 extern "C" volatile sig_atomic_t report_requested;
+extern "C" volatile sig_atomic_t reload_requested;
 
 unsigned long get_min(unsigned long g, unsigned long p);
 unsigned long get_max(unsigned long g, unsigned long p);
@@ -37,9 +40,15 @@ __attribute__((destructor)) void libnorsim_destructor()
 	fflush(stdout);
 }
 
+thread_local bool Libnorsim::m_constructing = false;
+
 Libnorsim::Libnorsim() 
- : m_initialized(false), m_opened(false), m_cacheFileFd(-1) {
+ : m_initialized(false), m_opened(false), m_batching(false), m_agePending(NULL), m_faultFile(NULL), m_faultFileIno(0), m_faultWatch(0),
+   m_faultCheckAt(0), m_faultReloads(0), m_faultReloadsFailed(0), m_cacheFileFd(-1), m_cacheFileAccess(O_RDWR), m_backingFd(-1), m_directIo(false) {
 	report_requested = 0;
+	reload_requested = 0;
+	memset(&m_faultFileTime, 0x00, sizeof(m_faultFileTime));
+	m_constructing = true;
 
 	initLogger();
 	if (!initSyscallsCache())
@@ -48,18 +57,39 @@ Libnorsim::Libnorsim()
 		goto err;
 	if (!initSizes())
 		goto err;
+	if (!initDirectIo())
+		goto err;
 	if (!initPageBuffer())
 		goto err;
+	if (!initSharedDevice())
+		goto err;
 
-	try {
-		m_pageManager.reset(new PageManager(*this, m_size / m_eraseSize));
-	} catch (std::exception &e) {
-		m_logger->log(Loglevel::FATAL, "%s", false, e.what());
+	if (!initDevice())
 		goto err;
-	}
 	initPageFailures();
+	if (!initFaultFile())
+		goto err;
+	if (m_sharedDevice)
+		m_sharedDevice->publish(getPageManager());
+	if (!initBlockCache())
+		goto err;
+	if (!initBackingIo())
+		goto err;
+	if (!initAging())
+		goto err;
+	if (!initPowerFail())
+		goto err;
+	if (!initTraceRecorder())
+		goto err;
+	initLatencyStats();
+	if (!initTimingModel())
+		goto err;
+	if (!initSyncPolicy())
+		goto err;
+	if (!initEraseEngine())
+		goto err;
 
-	if ((!m_pageManager->getWeakPageCount()) && (!m_pageManager->getGravePageCount()))
+	if ((!getPageManager().getWeakPageCount()) && (!getPageManager().getGravePageCount()))
 		m_logger->log(Loglevel::WARNING, "No failures defined, faults won't be forwarded to user program");
 
 	m_logger->log(Loglevel::ALWAYS, "SUMMARY:");
@@ -68,9 +98,12 @@ Libnorsim::Libnorsim()
 	initMtdInfo();
 	signal(SIGUSR1, sig_handler);
 	signal(SIGUSR2, sig_handler);
+	if (m_faultFile)
+		signal(SIGHUP, sig_handler);
 
 	m_logger->log(Loglevel::DEBUG, "Libnorsim init OK");
 	m_initialized = true;
+	m_constructing = false;
 	return;
 
 err:
@@ -80,6 +113,7 @@ err:
 }
 
 Libnorsim::~Libnorsim() {
+	std::lock_guard<std::mutex> lg(m_mutex);
 	m_logger->log(Loglevel::ALWAYS, "Page report:");
 	printPageReport(true);
 	m_logger->log(Loglevel::ALWAYS, "Statistics:");
@@ -87,14 +121,26 @@ Libnorsim::~Libnorsim() {
 }
 
 void Libnorsim::handleReportRequest() {
+	if (reload_requested || (m_faultWatch && isFaultFileChanged())) {
+		reload_requested = 0;
+		if (loadFaultFile()) {
+			m_faultReloads++;
+		} else {
+			m_faultReloadsFailed++;
+			m_logger->log(Loglevel::WARNING, "Couldn't reload fault file: %s, faults are kept", false, m_faultFile);
+		}
+	}
 	if (report_requested) {
 		if (!m_initialized) {
 			m_logger->log(Loglevel::WARNING, "Not initialized, no report available");
 		} else {
+			// localtime() would load timezone file through interposed open() with global mutex held
 			time_t cur_time = time(NULL);
-			struct tm *date_info = localtime(&cur_time);
+			struct tm date_info;
+			char date_buf[32];
+			gmtime_r(&cur_time, &date_info);
 
-			m_logger->log(Loglevel::ALWAYS, asctime(date_info), true);
+			m_logger->log(Loglevel::ALWAYS, asctime_r(&date_info, date_buf), true);
 			m_logger->log(Loglevel::ALWAYS, "Page report:");
 			switch (report_requested) {
 				case SIGNAL_REPORT_SHORT: printPageReport(false); break;
@@ -109,6 +155,31 @@ void Libnorsim::handleReportRequest() {
 	report_requested = 0;
 }
 
+// shared device is accessed by other processes, its blocks can't be cached
+void Libnorsim::beginBatch() {
+	if (m_blockCache || m_sharedDevice)
+		return;
+	if (!m_batchCache) {
+		unsigned blocks = getPageManager().getPageCount();
+		if (blocks > BLOCK_CACHE_BATCH)
+			blocks = BLOCK_CACHE_BATCH;
+		try {
+			m_batchCache.reset(new BlockCache(*this, getPageManager().getPageCount(), blocks));
+		} catch (std::exception &e) {
+			m_logger->log(Loglevel::WARNING, "%s, batch is done without it", false, e.what());
+			return;
+		}
+	}
+	m_batching = true;
+}
+
+bool Libnorsim::endBatch() {
+	if (!m_batching)
+		return (true);
+	m_batching = false;
+	return (m_batchCache->invalidate());
+}
+
 void Libnorsim::initLogger() {
 	char *env_log = getenv(ENV_LOG);
 	if (!env_log){
@@ -179,6 +250,14 @@ bool Libnorsim::initCacheFile() {
 		m_logger->log(Loglevel::FATAL, "Couldn't access file \"%s\"", false, m_cacheFile.get());
 		return(false);
 	}
+
+	struct stat st;
+	if (stat(m_cacheFile.get(), &st) < 0) {
+		m_logger->log(Loglevel::FATAL, "Couldn't stat file \"%s\"", false, m_cacheFile.get());
+		return(false);
+	}
+	m_cacheDev = st.st_dev;
+	m_cacheIno = st.st_ino;
 	return (true);
 }
 
@@ -188,7 +267,7 @@ bool Libnorsim::initSizes() {
 		m_logger->log(Loglevel::FATAL, "No size given");
 		return (false);
 	}
-	m_size = static_cast<unsigned>(strtoul(env_size, NULL, 10) * 1024);
+	m_size = strtoul(env_size, NULL, 10) * 1024;
 	m_logger->log(Loglevel::INFO, "Set size: 0x%lX (%lukB)", false, m_size, m_size / 1024);
 
 	struct stat st;
@@ -200,6 +279,32 @@ bool Libnorsim::initSizes() {
 		return (false);
 	}
 
+	char *env_erase_regions = getenv(ENV_ERASE_REGIONS);
+	if (env_erase_regions) {
+		std::vector<st_erase_region_t> regions;
+		if (!parseEraseRegions(env_erase_regions, regions)) {
+			m_logger->log(Loglevel::FATAL, "Couldn't parse erase regions: %s", false, env_erase_regions);
+			return (false);
+		}
+		try {
+			m_geometry.reset(new NorGeometry(regions));
+		} catch (std::exception &e) {
+			m_logger->log(Loglevel::FATAL, "%s", false, e.what());
+			return (false);
+		}
+		if (m_size != m_geometry->getSize()) {
+			m_logger->log(Loglevel::FATAL, "Erase regions don't cover flash size (%lukB != %lukB)",
+				false, m_geometry->getSize() / 1024, m_size / 1024);
+			return (false);
+		}
+		m_eraseSize = m_geometry->getEraseSize();
+		for (const st_erase_region_t &region : m_geometry->getRegions()) {
+			m_logger->log(Loglevel::INFO, "Set erase region: 0x%lX, %u x 0x%lX (%lukB)", false,
+				region.offset, region.blocks, region.eraseSize, region.eraseSize / 1024);
+		}
+		return (true);
+	}
+
 	char *env_erase_size = getenv(ENV_ERASE_SIZE);
 	if (!env_erase_size) {
 		m_logger->log(Loglevel::FATAL, "No erase_size given");
@@ -207,31 +312,524 @@ bool Libnorsim::initSizes() {
 	}
 	m_eraseSize = (unsigned)strtoul(env_erase_size, NULL, 10) * 1024;
 	m_logger->log(Loglevel::INFO, "Set erase size: 0x%lX (%lukB)", false, m_eraseSize, m_eraseSize / 1024);
+	try {
+		m_geometry.reset(new NorGeometry(m_size, m_eraseSize));
+	} catch (std::exception &e) {
+		m_logger->log(Loglevel::FATAL, "%s", false, e.what());
+		return (false);
+	}
 
 	return (true);
 }
 
+// comma separated <blocks>x<kB>, blocks of one of them can be * (rest of flash size)
+bool Libnorsim::parseEraseRegions(const char *env, std::vector<st_erase_region_t> &regions) {
+	const char *pos = env;
+	unsigned long covered = 0;
+	int rest = -1;
+	char *end;
+
+	while ('\0' != *pos) {
+		st_erase_region_t region = {0, 0, 0};
+		if (PARSE_SPAN_ALL == *pos) {
+			if (rest >= 0)
+				return (false);
+			rest = regions.size();
+			end = const_cast<char*>(pos + 1);
+		} else {
+			region.blocks = strtoul(pos, &end, 10);
+			if (end == pos)
+				return (false);
+		}
+		if (PARSE_REGION_SIZE != *end)
+			return (false);
+		pos = end + 1;
+		region.eraseSize = strtoul(pos, &end, 10) * 1024;
+		if ((end == pos) || (('\0' != *end) && (PARSE_PROP_DELIM != *end)))
+			return (false);
+		covered += region.blocks * region.eraseSize;
+		regions.push_back(region);
+		pos = ('\0' == *end)?(end):(end + 1);
+	}
+	if (rest >= 0) {
+		st_erase_region_t &region = regions[rest];
+		if ((0 == region.eraseSize) || (covered >= m_size) || (0 != ((m_size - covered) % region.eraseSize)))
+			return (false);
+		region.blocks = (m_size - covered) / region.eraseSize;
+	}
+	return (true);
+}
+
+bool Libnorsim::initDirectIo() {
+	char *env_direct_io = getenv(ENV_DIRECT_IO);
+	if ((!env_direct_io) || (0 == strtoul(env_direct_io, NULL, 10)))
+		return (true);
+	if (0 != (m_size % DIRECT_IO_ALIGNMENT)) {
+		m_logger->log(Loglevel::FATAL, "Flash size must be multiple of %ukB for direct I/O", false, DIRECT_IO_ALIGNMENT / 1024);
+		return (false);
+	}
+	m_directIo = true;
+	m_logger->log(Loglevel::INFO, "Set direct I/O (O_DIRECT) for cache file");
+	return (true);
+}
+
 bool Libnorsim::initPageBuffer() {
-	m_pageBuffer.reset(new char[m_eraseSize]);
+	m_pageBuffer.reset(allocAligned(m_eraseSize));
 	if (NULL == m_pageBuffer.get())
 		return (false);
 	return (true);
 }
 
+bool Libnorsim::initSharedDevice() {
+	char *env_shared = getenv(ENV_SHARED);
+	if ((!env_shared) || (0 == strtoul(env_shared, NULL, 10)))
+		return (true);
+
+	m_sharedDevice.reset(new SharedDevice(*this, m_cacheDev, m_cacheIno, m_geometry->getBlockCount()));
+	if (!m_sharedDevice->isOk()) {
+		m_logger->log(Loglevel::FATAL, "Shared device init FAILED!");
+		return (false);
+	}
+	return (true);
+}
+
+// faults are set up by initPageFailures()
+bool Libnorsim::initDevice() {
+	st_nor_config_t config;
+	memset(&config, 0x00, sizeof(config));
+	config.size = m_size;
+	config.eraseSize = m_eraseSize;
+	config.geometry = m_geometry.get();
+	config.seed = 1;
+	char *env_seed = getenv(ENV_SEED);
+	if (env_seed)
+		config.seed = strtoul(env_seed, NULL, 10);
+	m_storage.reset(new NorStorageLibnorsim(*this));
+	config.storage = m_storage.get();
+	config.observer = m_storage.get();
+	config.sharedPages = (m_sharedDevice)?(m_sharedDevice->getPages()):(NULL);
+	config.logger = m_logger.get();
+	char *env_program_check = getenv(ENV_PROGRAM_CHECK);
+	config.programCheck = (env_program_check) && (0 != strtoul(env_program_check, NULL, 10));
+
+	try {
+		m_device.reset(new NorDevice(config));
+	} catch (std::exception &e) {
+		m_logger->log(Loglevel::FATAL, "%s", false, e.what());
+		return (false);
+	}
+	if (env_seed)
+		m_logger->log(Loglevel::INFO, "Set random seed: %s", false, env_seed);
+	return (true);
+}
+
 void Libnorsim::initPageFailures() {
+	if ((m_sharedDevice) && !m_sharedDevice->isCreator()) {
+		st_shared_header_t &header = m_sharedDevice->getHeader();
+		getPageManager().setFaultSummary(header.weakPages, header.gravePages,
+			static_cast<e_beh_t>(header.behaviorWeak), static_cast<e_beh_t>(header.behaviorGrave));
+		m_logger->log(Loglevel::INFO, "Using faults of shared device, " ENV_WEAK_PAGES " and " ENV_GRAVE_PAGES " are ignored");
+		return;
+	}
+
 	char *env_weak_pages = getenv(ENV_WEAK_PAGES);
 	if (env_weak_pages)
-		m_pageManager->parseWeakPagesEnv(env_weak_pages);
+		m_device->parseWeakPages(env_weak_pages);
 	else
 		m_logger->log(Loglevel::WARNING, "No weak pages environment given, assuming no weak pages");
 
 	char *env_grave_pages = getenv(ENV_GRAVE_PAGES);
 	if (env_grave_pages)
-		m_pageManager->parseGravePagesEnv(env_grave_pages);
+		m_device->parseGravePages(env_grave_pages);
 	else
 		m_logger->log(Loglevel::WARNING, "No grave pages environment given, assuming no grave pages");
 }
 
+// Fault file replaces faults of environment, it's loaded again on SIGHUP and
+// when it changes (checked every NS_FAULT_WATCH ms by intercepted calls).
+bool Libnorsim::initFaultFile() {
+	char *env_fault_file = getenv(ENV_FAULT_FILE);
+	if (!env_fault_file)
+		return (true);
+	if (m_sharedDevice) {
+		m_logger->log(Loglevel::WARNING, "Fault file can't be used with shared device, disabled");
+		return (true);
+	}
+	m_faultFile = env_fault_file;
+	if (!loadFaultFile()) {
+		m_logger->log(Loglevel::FATAL, "Couldn't load fault file: %s", false, m_faultFile);
+		return (false);
+	}
+
+	char *env_fault_watch = getenv(ENV_FAULT_WATCH);
+	if (!env_fault_watch)
+		return (true);
+	char *end;
+	unsigned long ms = strtoul(env_fault_watch, &end, 10);
+	if ((end == env_fault_watch) || ('\0' != *end)) {
+		m_logger->log(Loglevel::FATAL, "Couldn't parse: \"%s\"", false, env_fault_watch);
+		return (false);
+	}
+	m_faultWatch = ms * 1000000ULL;
+	m_faultCheckAt = LatencyStats::now() + m_faultWatch;
+	m_logger->log(Loglevel::INFO, "Set fault file watch: %lu ms", false, ms);
+	return (true);
+}
+
+// "<env>=<spec>" lines of weak and grave pages, missing one means no faults of its type;
+// file is read through real calls (global mutex may be held) and applied as whole
+bool Libnorsim::loadFaultFile() {
+	std::string specs[2];
+	bool given[2] = {false, false};
+	const char * const names[2] = {ENV_WEAK_PAGES, ENV_GRAVE_PAGES};
+	bool ret = true;
+	char *line = NULL;
+	size_t size = 0;
+	ssize_t len;
+	struct stat st;
+
+	FILE *file = m_syscallsCache->invokeFopen(m_faultFile, "r");
+	if (NULL == file) {
+		m_logger->log(Loglevel::ERROR, "Couldn't open fault file: %s", false, m_faultFile);
+		return (false);
+	}
+	// file which can't be applied isn't read again until it changes
+	if (0 == fstat(fileno(file), &st)) {
+		m_faultFileTime = st.st_mtim;
+		m_faultFileIno = st.st_ino;
+	}
+	while (ret && ((len = getline(&line, &size, file)) >= 0)) {
+		while ((len > 0) && isspace(line[len - 1]))
+			line[--len] = '\0';
+		if ((0 == len) || (PARSE_FAULT_COMMENT == line[0]))
+			continue;
+		char *value = strchr(line, PARSE_FAULT_ASSIGN);
+		ret = false;
+		for (unsigned i = 0; (NULL != value) && (i < 2); ++i) {
+			if ((strlen(names[i]) == static_cast<size_t>(value - line)) && (0 == strncmp(line, names[i], value - line))) {
+				specs[i] = value + 1;
+				given[i] = ret = true;
+			}
+		}
+		if (!ret)
+			m_logger->log(Loglevel::ERROR, "Invalid line of fault file: \"%s\"", false, line);
+	}
+	free(line);
+	fclose(file);
+	if (!ret)
+		return (false);
+
+	if (!m_device->replaceFaults((given[0])?(specs[0].c_str()):(NULL), (given[1])?(specs[1].c_str()):(NULL)))
+		return (false);
+	m_logger->log(Loglevel::INFO, "Loaded faults from: %s (weak=%d, grave=%d)", false,
+		m_faultFile, getPageManager().getWeakPageCount(), getPageManager().getGravePageCount());
+	return (true);
+}
+
+// replacing file by rename changes inode
+bool Libnorsim::isFaultFileChanged() {
+	uint64_t now = LatencyStats::now();
+	struct stat st;
+
+	if (now < m_faultCheckAt)
+		return (false);
+	m_faultCheckAt = now + m_faultWatch;
+	if (stat(m_faultFile, &st) < 0)
+		return (false);
+	return ((st.st_ino != m_faultFileIno) ||
+		(st.st_mtim.tv_sec != m_faultFileTime.tv_sec) ||
+		(st.st_mtim.tv_nsec != m_faultFileTime.tv_nsec));
+}
+
+bool Libnorsim::initBlockCache() {
+	char *env_block_cache = getenv(ENV_BLOCK_CACHE);
+	if (!env_block_cache)
+		return (true);
+	unsigned long blocks = strtoul(env_block_cache, NULL, 10);
+	if (0 == blocks)
+		return (true);
+	if (m_sharedDevice) {
+		m_logger->log(Loglevel::WARNING, "Block cache can't be used with shared device, disabled");
+		return (true);
+	}
+	if (blocks > getPageManager().getPageCount())
+		blocks = getPageManager().getPageCount();
+
+	try {
+		m_blockCache.reset(new BlockCache(*this, getPageManager().getPageCount(), blocks));
+	} catch (std::exception &e) {
+		m_logger->log(Loglevel::FATAL, "%s", false, e.what());
+		return (false);
+	}
+	return (true);
+}
+
+// contents are changed by aging, it's applied by applyAging() when cache file is opened,
+// bit error rate grows with wear as well
+bool Libnorsim::initAging() {
+	char *env_wear_curve = getenv(ENV_WEAR_CURVE);
+	if (env_wear_curve && !m_device->setWearCurve(env_wear_curve))
+		return (false);
+	char *env_rber = getenv(ENV_RBER);
+	if (env_rber && !m_device->setBitErrorRate(env_rber))
+		return (false);
+
+	m_agePending = getenv(ENV_AGE);
+	if (!m_agePending)
+		return (true);
+	if ((m_sharedDevice) && !m_sharedDevice->isCreator()) {
+		m_logger->log(Loglevel::INFO, "Shared device is aged already, " ENV_AGE " is ignored");
+		m_agePending = NULL;
+		return (true);
+	}
+	if (m_device->parseAging(m_agePending, false) < 0) {
+		m_logger->log(Loglevel::FATAL, "Couldn't parse: \"%s\"", false, m_agePending);
+		return (false);
+	}
+	return (true);
+}
+
+// spec was checked by initAging()
+void Libnorsim::applyAging() {
+	if (NULL == m_agePending)
+		return;
+	m_logger->log(Loglevel::INFO, "Aged pages: %d", false, m_device->parseAging(m_agePending));
+	m_agePending = NULL;
+}
+
+// operations (programs and erases) are counted from start
+bool Libnorsim::initPowerFail() {
+	char *env_power_fail = getenv(ENV_POWER_FAIL);
+	if (!env_power_fail)
+		return (true);
+
+	char *end;
+	unsigned long first = strtoul(env_power_fail, &end, 10);
+	unsigned long last = first;
+	if ('-' == *end)
+		last = strtoul(end + 1, &end, 10);
+	if (('\0' != *end) || (0 == first) || (first > last)) {
+		m_logger->log(Loglevel::FATAL, "Couldn't parse: \"%s\"", false, env_power_fail);
+		return (false);
+	}
+	m_device->armPowerCut(first, last);
+	return (true);
+}
+
+bool Libnorsim::initBackingIo() {
+	char *env_backing_io = getenv(ENV_BACKING_IO);
+	if ((!env_backing_io) || (0 == strcmp(env_backing_io, PARSE_IO_SYNC))) {
+		m_backingIo.reset(BackingIoFactory::createBackingIoSync(*m_syscallsCache));
+	} else if (0 == strcmp(env_backing_io, PARSE_IO_URING)) {
+		m_backingIo.reset(BackingIoFactory::createBackingIoUring(*m_syscallsCache));
+		if (!m_backingIo->isOk()) {
+			m_logger->log(Loglevel::WARNING, "Couldn't set up io_uring, falling back to synchronous I/O");
+			m_backingIo.reset(BackingIoFactory::createBackingIoSync(*m_syscallsCache));
+		}
+	} else {
+		m_logger->log(Loglevel::FATAL, "Unknown backing I/O: %s", false, env_backing_io);
+		return (false);
+	}
+
+	if (m_directIo)
+		m_backingIo->setAlignment(DIRECT_IO_ALIGNMENT);
+
+	struct iovec iov[2];
+	unsigned iov_count = 0;
+	iov[iov_count].iov_base = m_pageBuffer.get();
+	iov[iov_count++].iov_len = m_eraseSize;
+	if (m_blockCache) {
+		iov[iov_count].iov_base = m_blockCache->getData();
+		iov[iov_count++].iov_len = m_blockCache->getDataSize();
+	}
+	m_backingIo->registerBuffers(iov, iov_count);
+
+	m_logger->log(Loglevel::INFO, "Set backing I/O: %s", false, m_backingIo->getName());
+	return (true);
+}
+
+bool Libnorsim::initTraceRecorder() {
+	char *env_trace = getenv(ENV_TRACE);
+	if (!env_trace)
+		return (true);
+
+	uint64_t ring_size = 0;
+	char *env_trace_ring = getenv(ENV_TRACE_RING);
+	if (env_trace_ring) {
+		ring_size = strtoull(env_trace_ring, NULL, 10) * 1024;
+		if ((0 != ring_size) && (ring_size < TRACE_RING_MIN_SIZE))
+			ring_size = TRACE_RING_MIN_SIZE;
+	}
+
+	uint32_t flags = 0;
+	char *env_trace_data = getenv(ENV_TRACE_DATA);
+	if (env_trace_data) {
+		if (0 == strcmp(env_trace_data, PARSE_TRACE_HASH)) {
+			flags = TRACE_FLAG_HASH;
+		} else if (0 == strcmp(env_trace_data, PARSE_TRACE_PAYLOAD)) {
+			flags = TRACE_FLAG_HASH | TRACE_FLAG_PAYLOAD;
+		} else {
+			m_logger->log(Loglevel::FATAL, "Unknown trace data mode: %s", false, env_trace_data);
+			return (false);
+		}
+	}
+
+	m_traceRecorder.reset(new TraceRecorder(*this, env_trace, ring_size, flags));
+	if (!m_traceRecorder->isOk()) {
+		m_logger->log(Loglevel::FATAL, "Trace recorder init FAILED!");
+		return (false);
+	}
+	return (true);
+}
+
+void Libnorsim::initLatencyStats() {
+	char *env_latency = getenv(ENV_LATENCY);
+	if ((!env_latency) || (0 == strtoul(env_latency, NULL, 10)))
+		return;
+	m_latencyStats.reset(new LatencyStats(*this));
+}
+
+bool Libnorsim::initSyncPolicy() {
+	char *env_sync = getenv(ENV_SYNC);
+	if (!env_sync)
+		return (true);
+
+	e_sync_mode_t mode;
+	unsigned long interval = 0;
+	if (0 == strcmp(env_sync, PARSE_SYNC_NONE)) {
+		mode = E_SYNC_NONE;
+	} else if (0 == strcmp(env_sync, PARSE_SYNC_CLOSE)) {
+		mode = E_SYNC_CLOSE;
+	} else if (0 == strcmp(env_sync, PARSE_SYNC_ERASE)) {
+		mode = E_SYNC_ERASE;
+	} else if (0 == strncmp(env_sync, PARSE_SYNC_OPS, strlen(PARSE_SYNC_OPS))) {
+		mode = E_SYNC_OPS;
+		interval = strtoul(&env_sync[strlen(PARSE_SYNC_OPS)], NULL, 10);
+	} else if (0 == strncmp(env_sync, PARSE_SYNC_MS, strlen(PARSE_SYNC_MS))) {
+		mode = E_SYNC_MS;
+		interval = strtoul(&env_sync[strlen(PARSE_SYNC_MS)], NULL, 10);
+	} else {
+		m_logger->log(Loglevel::FATAL, "Unknown sync policy: %s", false, env_sync);
+		return (false);
+	}
+	if (((E_SYNC_OPS == mode) || (E_SYNC_MS == mode)) && (0 == interval)) {
+		m_logger->log(Loglevel::FATAL, "Sync interval must be greater than 0: %s", false, env_sync);
+		return (false);
+	}
+
+	m_syncPolicy.reset(new SyncPolicy(*this, mode, interval));
+	if (interval)
+		m_logger->log(Loglevel::INFO, "Set sync policy: %s (%lu)", false, m_syncPolicy->getName(), interval);
+	else
+		m_logger->log(Loglevel::INFO, "Set sync policy: %s", false, m_syncPolicy->getName());
+	return (true);
+}
+
+bool Libnorsim::initEraseEngine() {
+	char *env_erase_async = getenv(ENV_ERASE_ASYNC);
+	if (!env_erase_async)
+		return (true);
+
+	e_erase_busy_t busy_mode;
+	if (0 == strcmp(env_erase_async, PARSE_ERASE_BLOCK)) {
+		busy_mode = E_ERASE_BUSY_BLOCK;
+	} else if (0 == strcmp(env_erase_async, PARSE_ERASE_EBUSY)) {
+		busy_mode = E_ERASE_BUSY_EBUSY;
+	} else {
+		m_logger->log(Loglevel::FATAL, "Unknown asynchronous erase mode: %s", false, env_erase_async);
+		return (false);
+	}
+
+	unsigned long erase_time = 0;
+	char *env_erase_time = getenv(ENV_ERASE_TIME);
+	if (env_erase_time)
+		erase_time = strtoul(env_erase_time, NULL, 10) * 1000;
+	unsigned long suspend = 0;
+	char *env_erase_suspend = getenv(ENV_ERASE_SUSPEND);
+	if (env_erase_suspend)
+		suspend = strtoul(env_erase_suspend, NULL, 10);
+
+	m_eraseEngine.reset(new EraseEngine(*this, getPageManager().getPageCount(), busy_mode, erase_time, suspend));
+	m_logger->log(Loglevel::INFO, "Set asynchronous erase: %s, erase time: %lums, suspend latency: %luus", false,
+		env_erase_async, erase_time / 1000, suspend);
+	return (true);
+}
+
+bool Libnorsim::initTimingModel() {
+	char *env_timing = getenv(ENV_TIMING);
+	if (!env_timing)
+		return (true);
+
+	st_timing_t timing;
+	timing.byteProgram = {TIMING_DEFAULT_BYTE_TYP_US * 1000ULL, TIMING_DEFAULT_BYTE_MAX_US * 1000ULL};
+	timing.bufferProgram = {TIMING_DEFAULT_BUFFER_TYP_US * 1000ULL, TIMING_DEFAULT_BUFFER_MAX_US * 1000ULL};
+	timing.bufferSize = TIMING_DEFAULT_BUFFER_SIZE;
+	timing.erase = {TIMING_DEFAULT_ERASE_TYP_MS * 1000000ULL, TIMING_DEFAULT_ERASE_MAX_MS * 1000000ULL};
+	timing.readPerKByte = 1000000ULL / TIMING_DEFAULT_READ_MBPS;
+	if ((0 != strcmp(env_timing, PARSE_TIMING_DEFAULT)) && !parseTiming(env_timing, timing)) {
+		m_logger->log(Loglevel::FATAL, "Couldn't parse timing: %s", false, env_timing);
+		return (false);
+	}
+
+	e_timing_mode_t mode = E_TIMING_VIRTUAL;
+	unsigned long acceleration = 1;
+	char *env_timing_mode = getenv(ENV_TIMING_MODE);
+	if ((env_timing_mode) && (0 != strcmp(env_timing_mode, PARSE_TIMING_VIRTUAL))) {
+		char *end;
+		mode = E_TIMING_REAL;
+		if (0 != strcmp(env_timing_mode, PARSE_TIMING_REAL)) {
+			acceleration = strtoul(env_timing_mode, &end, 10);
+			if ((0 == acceleration) || (PARSE_TIMING_ACCEL != end[0]) || ('\0' != end[1])) {
+				m_logger->log(Loglevel::FATAL, "Unknown timing mode: %s", false, env_timing_mode);
+				return (false);
+			}
+		}
+	}
+
+	m_timingModel.reset(new TimingModel(*this, timing, mode, acceleration));
+	if (E_TIMING_VIRTUAL == mode)
+		m_logger->log(Loglevel::INFO, "Set timing mode: virtual clock");
+	else
+		m_logger->log(Loglevel::INFO, "Set timing mode: real time, accelerated %lux", false, acceleration);
+	return (true);
+}
+
+// comma separated <key>=<value>[:<value>...], times in us (erase in ms), read in MB/s
+bool Libnorsim::parseTiming(const char *env, st_timing_t &timing) {
+	const char *pos = env;
+	while ('\0' != *pos) {
+		const char *assign = strchr(pos, PARSE_TIMING_ASSIGN);
+		if (NULL == assign)
+			return (false);
+		std::string key(pos, assign - pos);
+		unsigned long values[3];
+		unsigned count = 0;
+		char *end = const_cast<char*>(assign);
+		do {
+			if (count == sizeof(values) / sizeof(values[0]))
+				return (false);
+			values[count++] = strtoul(end + 1, &end, 10);
+		} while (PARSE_SPAN_DELIM == *end);
+		if (('\0' != *end) && (PARSE_PROP_DELIM != *end))
+			return (false);
+
+		if ((PARSE_TIMING_BYTE == key) && (count <= 2)) {
+			timing.byteProgram = {values[0] * 1000ULL, values[count - 1] * 1000ULL};
+		} else if ((PARSE_TIMING_BUFFER == key) && (count >= 2)) {
+			timing.bufferSize = values[0];
+			timing.bufferProgram = {values[1] * 1000ULL, values[count - 1] * 1000ULL};
+		} else if ((PARSE_TIMING_ERASE == key) && (count <= 2)) {
+			timing.erase = {values[0] * 1000000ULL, values[count - 1] * 1000000ULL};
+		} else if ((PARSE_TIMING_READ == key) && (1 == count) && (0 != values[0])) {
+			timing.readPerKByte = 1000000ULL / values[0];
+		} else {
+			return (false);
+		}
+		pos = ('\0' == *end)?(end):(end + 1);
+	}
+	return (true);
+}
+
 void Libnorsim::initMtdInfo() {
 	memset(&m_mtdInfo, 0x00, sizeof(mtd_info_t));
 	m_mtdInfo.type = MTD_NORFLASH;
@@ -251,13 +849,62 @@ void Libnorsim::printUsage() {
 	puts("\t" ENV_CACHE_FILE  ":\tpath to file which will be used as storage");
 	puts("\t" ENV_SIZE        ":\tsize of flash device (decimal number in kBytes)");
 	puts("\t" ENV_ERASE_SIZE  ":\tsize of erase page (decimal number in kBytes");
+	puts("\t" ENV_ERASE_REGIONS ":\terase regions of pages of different sizes (like boot sectors) used instead of " ENV_ERASE_SIZE ":");
+	puts("\t\t\tcomma separated <pages>x<kBytes> in order of offsets, <pages> of one of them can be * (rest of size)");
 	puts("\t" ENV_WEAK_PAGES  ":\tpages marked as weak (see format description)");
 	puts("\t" ENV_GRAVE_PAGES ":\tpages marked as grave (see format description)");
+	puts("\t" ENV_SEED        ":\tseed used for random page selection, limits and dead bits (decimal number)");
+	puts("\t" ENV_BLOCK_CACHE ":\tnumber of eraseblocks kept in write-back cache (decimal number, 0 - disabled)");
+	puts("\t" ENV_DIRECT_IO   ":\t1 - access cache file with O_DIRECT bypassing page cache, 0 - disabled (default)");
+	puts("\t" ENV_TRACE       ":\tpath to file where binary trace of operations on cache file will be recorded");
+	puts("\t" ENV_TRACE_RING  ":\tsize of trace ring (decimal number in kBytes), 0 - trace file grows as needed (default)");
+	puts("\t" ENV_TRACE_DATA  ":\t" PARSE_TRACE_HASH " - record hash of transferred data, " PARSE_TRACE_PAYLOAD " - record data and its hash");
+	puts("\t" ENV_LATENCY     ":\t1 - collect latency histograms of operations and their phases, 0 - disabled (default)");
+	puts("\t" ENV_SYNC        ":\t" PARSE_SYNC_NONE " - fsync() on cache file is ignored, " PARSE_SYNC_CLOSE " - sync on close, "
+		PARSE_SYNC_ERASE " - sync after every erase,");
+	puts("\t\t\t" PARSE_SYNC_OPS "<n>/" PARSE_SYNC_MS "<n> - background sync after n writes and erases/every n milliseconds,");
+	puts("\t\t\tall but " PARSE_SYNC_NONE " sync on close too (not set: fsync() on cache file is passed through)");
+	puts("\t" ENV_ERASE_ASYNC   ":\terase in background, access to erased block: " PARSE_ERASE_BLOCK " - waits, " PARSE_ERASE_EBUSY " - fails with EBUSY");
+	puts("\t" ENV_ERASE_TIME    ":\tduration of asynchronous erase of single eraseblock (decimal number in ms, default: 0),");
+	puts("\t\t\tignored with " ENV_TIMING ", erase time of timing model is used");
+	puts("\t" ENV_ERASE_SUSPEND ":\terase suspend latency paid by access to other block during erase, which prolongs erase");
+	puts("\t\t\t(decimal number in us, 0 - no suspend, other blocks are accessed freely (default))");
+	puts("\t" ENV_TIMING        ":\ttiming model advancing virtual clock: " PARSE_TIMING_DEFAULT " or comma separated (missing ones take defaults):");
+	puts("\t\t\t" PARSE_TIMING_BYTE "=<typ>[:<max>] - byte program (us), " PARSE_TIMING_BUFFER "=<bytes>:<typ>[:<max>] - buffer program (us),");
+	puts("\t\t\t" PARSE_TIMING_ERASE "=<typ>[:<max>] - sector erase (ms), " PARSE_TIMING_READ "=<MB/s> - read throughput");
+	puts("\t\t\tmax times are reached by weak pages at the end of their life");
+	puts("\t" ENV_TIMING_MODE   ":\t" PARSE_TIMING_VIRTUAL " - only count virtual clock (default), " PARSE_TIMING_REAL " - pace operations in real time,");
+	puts("\t\t\t<n>x - pace operations n times faster than real time");
+	puts("\t" ENV_SHARED        ":\t1 - page states (counters, faults, locks) are shared by all processes using same cache file,");
+	puts("\t\t\tfaults are set up by first one (" ENV_BLOCK_CACHE " is disabled), 0 - disabled (default)");
+	puts("\t" ENV_WEAR_CURVE    ":\tendurance of pages without faults (<cycles> format of weak pages), used by aging:");
+	puts("\t\t\taged page becomes weak one failing at cycles drawn from curve beyond those it had already");
+	puts("\t" ENV_AGE           ":\tcycles added at start: (<pages>,<erases>[,<programs>];)+, <pages>: <page>, <first>-<last>, *");
+	puts("\t\t\tworn out pages get dead bits in contents (NORSIM_IOC_AGE ioctl does the same at runtime)");
+	puts("\t" ENV_RBER          ":\traw bit error rate of reads: comma separated " PARSE_RBER_BASE "=<rate>, " PARSE_RBER_ERASE "=<coef>[:<exp>], " PARSE_RBER_READ "=<coef>,");
+	puts("\t\t\trate of page is base + coef * erases^exp (default exp: 1) + coef * reads, up to 0.5");
+	puts("\t" ENV_POWER_FAIL    ":\tpower cut at program or erase: <n>, <first>-<last> (drawn randomly), counted from start;");
+	puts("\t\t\tit's left partially done, all operations fail with EIO until device is reopened (or NORSIM_IOC_POWER_ON)");
+	puts("\t" ENV_PROGRAM_CHECK ":\t1 - count bits changed by programs, bytes rewritten with same value and attempts to program");
+	puts("\t\t\tbits 0->1 per page (shown in detailed page report), 0 - disabled (default)");
+	puts("\t" ENV_FAULT_FILE    ":\tfile of " ENV_WEAK_PAGES "=<format> and " ENV_GRAVE_PAGES "=<format> lines (missing one - no such pages),");
+	puts("\t\t\treplacing faults of environment, reloaded on SIGHUP (new faults replace all of them at once,");
+	puts("\t\t\tinvalid file is ignored, counters are kept)");
+	puts("\t" ENV_FAULT_WATCH   ":\tinterval of checking fault file for changes (decimal number in ms), reloaded when changed");
+	puts("\t" ENV_BACKING_IO  ":\tcache file I/O: " PARSE_IO_SYNC " (default), " PARSE_IO_URING " (falls back to " PARSE_IO_SYNC " if unavailable)");
 	puts("");
 	puts("format used by weak and grave pages:");
-	puts("\t(([rnd|eio])? <page_number>,<cycles>;)+");
-	puts("example:");
+	puts("\t([rnd|eio] )?((<pages>,<cycles>[,rnd|eio];)+|@<fault_map_file>)");
+	puts("\t<pages>:  <page>, <first>-<last>, * (all pages), optionally followed by /<stride>");
+	puts("\t          and/or :<percent>% to pick given percentage of them randomly (<percent>% alone means all pages)");
+	puts("\t<cycles>: <number>, uni:<min>:<max> (uniform), wbl:<shape>:<scale> (weibull)");
+	puts("\t          optionally followed by failure type of these pages (instead of one given for all)");
+	puts("\tfault map file: binary \"" FAULT_MAP_MAGIC "\" header (magic, version, count, reserved) followed by count pairs of");
+	puts("\t                <page>,<cycles> (all fields 32-bit host endian)");
+	puts("examples:");
 	puts("\teio 1,3;1024,10; - page 1 and 1024 will be marked weak with 3 and 10 cycles accordingly and operations will result in \"eio\" error");
+	puts("\trnd 100-4095/2,10; - every second page from 100 to 4095 will fail after 10 cycles");
+	puts("\t3%,wbl:1.5:1000; - 3% of all pages will fail after cycles drawn from weibull distribution");
 	puts("");
 	puts("failure types:");
 	puts("\teio:   page operation return -1");
@@ -268,14 +915,13 @@ void Libnorsim::printUsage() {
 	puts("\tgrave: page will start failing during read operations after given amount of cycles");
 }
 
+// callers hold global mutex, reports are requested from within intercepted syscalls
 void Libnorsim::printPageReport(bool detailed)
 {
-	std::lock_guard<std::mutex> lg(m_mutex);
-
 	long remaining;
-	for (unsigned i = 0; i < m_pageManager->getPageCount(); ++i) {
-		st_page_t page = m_pageManager->getPage(i);
-		switch (m_pageManager->getPage(i).type) {
+	for (unsigned i = 0; i < getPageManager().getPageCount(); ++i) {
+		st_page_t page = getPageManager().getPage(i);
+		switch (getPageManager().getPage(i).type) {
 			case E_PAGE_NORMAL:
 				if (detailed && (page.reads || page.writes || page.erases)) {
 					m_logger->log(Loglevel::ALWAYS, "\tPage %5u: N(reads=%lu, writes=%lu, erases=%lu)", false,
@@ -302,6 +948,12 @@ void Libnorsim::printPageReport(bool detailed)
 			default:
 				break;
 		}
+		const st_program_stats_t *program = m_device->getProgramStats(i);
+		if (detailed && (NULL != program) && (program->programs)) {
+			m_logger->log(Loglevel::ALWAYS, "\t            program(bytes=%lu, programmed bits=%lu, identical bytes=%lu, violations=%lu, illegal bits=%lu)", false,
+				program->bytes, program->programmedBits, program->identicalBytes, program->violations, program->illegalBits
+			);
+		}
 	}
 }
 
@@ -311,9 +963,8 @@ void Libnorsim::printPageStatistics() {
 	memset (&weak, 0x00, sizeof(weak));
 	memset (&grave, 0x00, sizeof(grave));
 
-	m_mutex.lock();
-	for (unsigned i = 0; i < m_pageManager->getPageCount(); ++i) {
-		switch (m_pageManager->getPage(i).type) {
+	for (unsigned i = 0; i < getPageManager().getPageCount(); ++i) {
+		switch (getPageManager().getPage(i).type) {
 			case E_PAGE_NORMAL:
 				STATS_FILL(normal,max,reads); STATS_FILL(normal,max,writes); STATS_FILL(normal,max,erases);
 				break;
@@ -330,8 +981,8 @@ void Libnorsim::printPageStatistics() {
 	normal.min_reads = normal.max_reads; normal.min_writes = normal.max_writes; normal.min_erases = normal.max_erases;
 	weak.min_reads = weak.max_reads; weak.min_writes = weak.max_writes; weak.min_erases = weak.max_erases;
 	grave.min_reads = grave.max_reads; grave.min_writes = grave.max_writes; grave.min_erases = grave.max_erases;
-	for (unsigned i = 0; i < m_pageManager->getPageCount(); ++i) {
-		switch (m_pageManager->getPage(i).type) {
+	for (unsigned i = 0; i < getPageManager().getPageCount(); ++i) {
+		switch (getPageManager().getPage(i).type) {
 			case E_PAGE_NORMAL:
 				STATS_FILL(normal,min,reads); STATS_FILL(normal,min,writes); STATS_FILL(normal,min,erases);
 				break;
@@ -345,7 +996,6 @@ void Libnorsim::printPageStatistics() {
 				break;
 		}
 	}
-	m_mutex.unlock();
 
 	m_logger->log(Loglevel::ALWAYS, "\tNORMAL pages:");
 	m_logger->log(Loglevel::ALWAYS, "\t\tmin reads:  %lu", false, normal.min_reads);
@@ -370,4 +1020,70 @@ void Libnorsim::printPageStatistics() {
 	m_logger->log(Loglevel::ALWAYS, "\t\tmax writes: %lu", false, grave.max_writes);
 	m_logger->log(Loglevel::ALWAYS, "\t\tmin erases: %lu", false, grave.min_erases);
 	m_logger->log(Loglevel::ALWAYS, "\t\tmax erases: %lu", false, grave.max_erases);
+
+	if (m_blockCache) {
+		m_logger->log(Loglevel::ALWAYS, "\tBLOCK cache:");
+		m_logger->log(Loglevel::ALWAYS, "\t\thits:       %lu", false, m_blockCache->getStats().hits);
+		m_logger->log(Loglevel::ALWAYS, "\t\tmisses:     %lu", false, m_blockCache->getStats().misses);
+		m_logger->log(Loglevel::ALWAYS, "\t\twritebacks: %lu", false, m_blockCache->getStats().writebacks);
+	}
+	if (m_sharedDevice) {
+		m_logger->log(Loglevel::ALWAYS, "\tSHARED device: %s", false, m_sharedDevice->getName());
+		m_logger->log(Loglevel::ALWAYS, "\t\tattached:   %u", false, m_sharedDevice->getHeader().attached);
+		m_logger->log(Loglevel::ALWAYS, "\t\tcontended:  %lu", false, m_sharedDevice->getStats().contended);
+		m_logger->log(Loglevel::ALWAYS, "\t\trecovered:  %lu", false, m_sharedDevice->getStats().recovered);
+	}
+	if (m_timingModel) {
+		m_logger->log(Loglevel::ALWAYS, "\tTIMING [us]:");
+		m_logger->log(Loglevel::ALWAYS, "\t\tclock:      %lu", false, m_timingModel->getClock().now / 1000);
+		m_logger->log(Loglevel::ALWAYS, "\t\tread:       %lu", false, m_timingModel->getClock().read / 1000);
+		m_logger->log(Loglevel::ALWAYS, "\t\tprogram:    %lu", false, m_timingModel->getClock().program / 1000);
+		m_logger->log(Loglevel::ALWAYS, "\t\terase:      %lu", false, m_timingModel->getClock().erase / 1000);
+	}
+	if (m_eraseEngine) {
+		m_logger->log(Loglevel::ALWAYS, "\tERASE engine:");
+		m_logger->log(Loglevel::ALWAYS, "\t\tqueued:     %lu", false, m_eraseEngine->getStats().queued);
+		m_logger->log(Loglevel::ALWAYS, "\t\tcompleted:  %lu", false, m_eraseEngine->getStats().completed);
+		m_logger->log(Loglevel::ALWAYS, "\t\twaits:      %lu", false, m_eraseEngine->getStats().waits);
+		m_logger->log(Loglevel::ALWAYS, "\t\trejected:   %lu", false, m_eraseEngine->getStats().rejected);
+		m_logger->log(Loglevel::ALWAYS, "\t\tsuspends:   %lu", false, m_eraseEngine->getStats().suspends);
+	}
+	if (m_syncPolicy) {
+		m_logger->log(Loglevel::ALWAYS, "\tSYNC policy: %s", false, m_syncPolicy->getName());
+		m_logger->log(Loglevel::ALWAYS, "\t\trequests:   %lu", false, m_syncPolicy->getStats().requests);
+		m_logger->log(Loglevel::ALWAYS, "\t\tskipped:    %lu", false, m_syncPolicy->getStats().skipped);
+		m_logger->log(Loglevel::ALWAYS, "\t\tsyncs:      %lu", false, m_syncPolicy->getStats().syncs);
+		m_logger->log(Loglevel::ALWAYS, "\t\tbackground: %lu", false, m_syncPolicy->getStats().background);
+	}
+	if (m_device->hasBitErrors()) {
+		m_logger->log(Loglevel::ALWAYS, "\tBIT errors:");
+		m_logger->log(Loglevel::ALWAYS, "\t\treads:      %lu", false, m_device->getStats().bitErrorReads);
+		m_logger->log(Loglevel::ALWAYS, "\t\tbits:       %lu", false, m_device->getStats().bitErrors);
+	}
+	if (NULL != m_device->getProgramStats(0)) {
+		const st_program_stats_t &program = m_device->getProgramTotals();
+		m_logger->log(Loglevel::ALWAYS, "\tPROGRAM check:");
+		m_logger->log(Loglevel::ALWAYS, "\t\tprograms:   %lu", false, program.programs);
+		m_logger->log(Loglevel::ALWAYS, "\t\tbytes:      %lu", false, program.bytes);
+		m_logger->log(Loglevel::ALWAYS, "\t\tprog. bits: %lu (%lu%% of written)", false, program.programmedBits,
+			(program.bytes)?(program.programmedBits * 100 / (program.bytes * 8)):(0));
+		m_logger->log(Loglevel::ALWAYS, "\t\tidentical:  %lu bytes", false, program.identicalBytes);
+		m_logger->log(Loglevel::ALWAYS, "\t\tviolations: %lu (%lu bits)", false, program.violations, program.illegalBits);
+	}
+	if (m_faultFile) {
+		m_logger->log(Loglevel::ALWAYS, "\tFAULT file:");
+		m_logger->log(Loglevel::ALWAYS, "\t\treloads:    %lu", false, m_faultReloads);
+		m_logger->log(Loglevel::ALWAYS, "\t\tfailed:     %lu", false, m_faultReloadsFailed);
+	}
+	if ((m_device->getStats().powerCuts) || (m_device->getJournal())) {
+		m_logger->log(Loglevel::ALWAYS, "\tPOWER:");
+		m_logger->log(Loglevel::ALWAYS, "\t\tcuts:       %lu", false, m_device->getStats().powerCuts);
+		m_logger->log(Loglevel::ALWAYS, "\t\trollbacks:  %lu", false, m_device->getStats().rollbacks);
+		if (m_device->getJournal()) {
+			m_logger->log(Loglevel::ALWAYS, "\t\trecords:    %lu", false, m_device->getJournal()->getRecordCount());
+			m_logger->log(Loglevel::ALWAYS, "\t\tjournal kB: %lu", false, m_device->getJournal()->getDataSize() / 1024);
+		}
+	}
+	if (m_latencyStats)
+		m_latencyStats->print();
 }
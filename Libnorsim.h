@@ -6,27 +6,86 @@
 #define ENV_CACHE_FILE  "NS_CACHE_FILE"
 #define ENV_SIZE        "NS_SIZE"
 #define ENV_ERASE_SIZE  "NS_ERASE_SIZE"
+#define ENV_ERASE_REGIONS "NS_ERASE_REGIONS"
 #define ENV_WEAK_PAGES  "NS_WEAK_PAGES"
 #define ENV_GRAVE_PAGES "NS_GRAVE_PAGES"
-
-#define PARSE_BEH_EIO "eio"
-#define PARSE_BEH_RND "rnd"
-#define PARSE_BEH_LEN 3
-
-#define PARSE_NODE_DELIM   ';'
-#define PARSE_PROP_DELIM   ','
-#define PARSE_PREFIX_DELIM ' '
+#define ENV_SEED        "NS_SEED"
+#define ENV_BLOCK_CACHE "NS_BLOCK_CACHE"
+#define ENV_BACKING_IO  "NS_BACKING_IO"
+#define ENV_DIRECT_IO   "NS_DIRECT_IO"
+#define ENV_TRACE       "NS_TRACE"
+#define ENV_TRACE_RING  "NS_TRACE_RING"
+#define ENV_TRACE_DATA  "NS_TRACE_DATA"
+#define ENV_LATENCY     "NS_LATENCY"
+#define ENV_SYNC        "NS_SYNC"
+#define ENV_ERASE_ASYNC   "NS_ERASE_ASYNC"
+#define ENV_ERASE_TIME    "NS_ERASE_TIME"
+#define ENV_ERASE_SUSPEND "NS_ERASE_SUSPEND"
+#define ENV_TIMING        "NS_TIMING"
+#define ENV_TIMING_MODE   "NS_TIMING_MODE"
+#define ENV_SHARED        "NS_SHARED"
+#define ENV_WEAR_CURVE    "NS_WEAR_CURVE"
+#define ENV_AGE           "NS_AGE"
+#define ENV_POWER_FAIL    "NS_POWER_FAIL"
+#define ENV_PROGRAM_CHECK "NS_PROGRAM_CHECK"
+#define ENV_RBER          "NS_RBER"
+#define ENV_FAULT_FILE    "NS_FAULT_FILE"
+#define ENV_FAULT_WATCH   "NS_FAULT_WATCH"
+
+#define PARSE_IO_SYNC  "sync"
+#define PARSE_IO_URING "uring"
+
+#define PARSE_TRACE_HASH    "hash"
+#define PARSE_TRACE_PAYLOAD "payload"
+
+#define PARSE_SYNC_NONE  "none"
+#define PARSE_SYNC_CLOSE "close"
+#define PARSE_SYNC_ERASE "erase"
+#define PARSE_SYNC_OPS   "ops:"
+#define PARSE_SYNC_MS    "ms:"
+
+#define PARSE_ERASE_BLOCK "block"
+#define PARSE_ERASE_EBUSY "ebusy"
+
+#define PARSE_TIMING_DEFAULT "default"
+#define PARSE_TIMING_BYTE    "byte"
+#define PARSE_TIMING_BUFFER  "buffer"
+#define PARSE_TIMING_ERASE   "erase"
+#define PARSE_TIMING_READ    "read"
+#define PARSE_TIMING_ASSIGN  '='
+#define PARSE_TIMING_VIRTUAL "virtual"
+#define PARSE_TIMING_REAL    "real"
+#define PARSE_TIMING_ACCEL   'x'
+
+#define PARSE_REGION_SIZE 'x'
+
+#define PARSE_FAULT_ASSIGN  '='
+#define PARSE_FAULT_COMMENT '#'
 
 #define SIGNAL_REPORT_SHORT 1
 #define SIGNAL_REPORT_DETAILED 2
 
 #include <memory>
 #include <mutex>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/stat.h>
 
 #include <mtd/mtd-user.h>
 
+#include "BackingIo.h"
+#include "BlockCache.h"
+#include "EraseEngine.h"
+#include "LatencyStats.h"
+#include "NorDevice.h"
+#include "NorStorageLibnorsim.h"
 #include "PageManager.h"
+#include "SharedDevice.h"
+#include "SyncPolicy.h"
 #include "SyscallsCache.h"
+#include "TimingModel.h"
+#include "TraceRecorder.h"
 
 class Logger;
 class LogFormatter;
@@ -40,19 +99,45 @@ public:
 	}
 
 	SyscallsCache& getSyscallsCache() { return (*m_syscallsCache.get()); }
-	PageManager& getPageManager() { return (*m_pageManager.get()); }
+	NorDevice& getDevice() { return (*m_device.get()); }
+	PageManager& getPageManager() { return (m_device->getPageManager()); }
+	SharedDevice* getSharedDevice() { return (m_sharedDevice.get()); }
+	BlockCache* getBlockCache() { return ((m_batching)?(m_batchCache.get()):(m_blockCache.get())); }
+	BackingIo& getBackingIo() { return (*m_backingIo.get()); }
+	TraceRecorder* getTraceRecorder() { return (m_traceRecorder.get()); }
+	LatencyStats* getLatencyStats() { return (m_latencyStats.get()); }
+	SyncPolicy* getSyncPolicy() { return (m_syncPolicy.get()); }
+	EraseEngine* getEraseEngine() { return (m_eraseEngine.get()); }
+	TimingModel* getTimingModel() { return (m_timingModel.get()); }
 	Logger& getLogger() { return (*m_logger.get()); }
 
 	bool isInitialized() { return (m_initialized); }
 
+	// set in thread running constructor, functions it calls (like fopen()
+	// opening log file) must not reach getInstance() again
+	static bool isConstructing() { return (m_constructing); }
+
 	std::mutex& getGlobalMutex() { return (m_mutex); }
 
 	char* getCacheFile() { return (m_cacheFile.get()); }
+	bool isCacheFile(const struct stat &st) { return ((st.st_ino == m_cacheIno) && (st.st_dev == m_cacheDev)); }
 	mtd_info_t* getMtdInfo() { return (&m_mtdInfo); }
+	unsigned long getSize() { return (m_size); }
+	// largest eraseblock when device has erase regions
 	unsigned long getEraseSize() { return (m_eraseSize); }
+	NorGeometry& getGeometry() { return (*m_geometry.get()); }
 
 	int getCacheFileFd() { return (m_cacheFileFd); }
 	void setCacheFileFd(int fd) { m_cacheFileFd = fd; }
+	// access mode requested by caller (O_RDONLY, O_WRONLY or O_RDWR), device itself is opened for both
+	bool isCacheFileReadable() { return (O_WRONLY != m_cacheFileAccess); }
+	bool isCacheFileWritable() { return (O_RDONLY != m_cacheFileAccess); }
+	void setCacheFileAccess(int access) { m_cacheFileAccess = access; }
+
+	// descriptor used for emulated I/O, separate one is opened in O_DIRECT mode
+	int getBackingFd() { return ((m_backingFd < 0)?(m_cacheFileFd):(m_backingFd)); }
+	void setBackingFd(int fd) { m_backingFd = fd; }
+	bool isDirectIo() { return (m_directIo); }
 
 	char* getPageBuffer() { return (m_pageBuffer.get()); }
 
@@ -60,7 +145,14 @@ public:
 	void setOpened() { m_opened = true; }
 	void setClosed() { m_opened = false; }
 
+	// handles requests of signals (reports, reload of fault file) and changes of watched fault file
 	void handleReportRequest();
+	// NS_AGE, done once
+	void applyAging();
+
+	// operations between them are done with block cache (temporary one without NS_BLOCK_CACHE)
+	void beginBatch();
+	bool endBatch();
 
 private:
 	Libnorsim();
@@ -73,8 +165,25 @@ private:
 	bool initCacheFile();
 	bool initSizes();
 	bool initPageBuffer();
+	bool initSharedDevice();
+	bool initDevice();
 	void initPageFailures();
-	
+	bool initBlockCache();
+	bool initBackingIo();
+	bool initAging();
+	bool initPowerFail();
+	bool initFaultFile();
+	bool initDirectIo();
+	bool initTraceRecorder();
+	void initLatencyStats();
+	bool initSyncPolicy();
+	bool initEraseEngine();
+	bool initTimingModel();
+	bool parseTiming(const char *env, st_timing_t &timing);
+	bool parseEraseRegions(const char *env, std::vector<st_erase_region_t> &regions);
+	bool loadFaultFile();
+	bool isFaultFileChanged();
+
 	void initMtdInfo();
 
 	void printUsage();
@@ -82,23 +191,52 @@ private:
 	void printPageReport(bool detailed = false);
 	void printPageStatistics();
 
+	static thread_local bool m_constructing;
 	bool m_initialized;
 	bool m_opened;
 	std::unique_ptr<LogFormatter> m_logFormatter;
 	std::unique_ptr<Logger> m_logger;
 	std::unique_ptr<SyscallsCache> m_syscallsCache;
-	std::unique_ptr<PageManager> m_pageManager;
+	std::unique_ptr<SharedDevice> m_sharedDevice;
+	std::unique_ptr<NorStorageLibnorsim> m_storage;
+	std::unique_ptr<NorDevice> m_device;
+	std::unique_ptr<BackingIo> m_backingIo;
+	std::unique_ptr<BlockCache> m_blockCache;
+	std::unique_ptr<BlockCache> m_batchCache;
+	bool m_batching;
+	const char *m_agePending;
+	const char *m_faultFile;
+	struct timespec m_faultFileTime;
+	ino_t m_faultFileIno;
+	uint64_t m_faultWatch;
+	uint64_t m_faultCheckAt;
+	unsigned long m_faultReloads;
+	unsigned long m_faultReloadsFailed;
+	std::unique_ptr<TraceRecorder> m_traceRecorder;
+	std::unique_ptr<LatencyStats> m_latencyStats;
+	std::unique_ptr<TimingModel> m_timingModel;
 	std::mutex m_mutex;
 
 	std::unique_ptr<char> m_cacheFile;
-	std::unique_ptr<char> m_pageBuffer;
+	dev_t m_cacheDev;
+	ino_t m_cacheIno;
+	aligned_buffer_t m_pageBuffer;
 
 	unsigned long m_size;
 	unsigned long m_eraseSize;
+	std::unique_ptr<NorGeometry> m_geometry;
 
 	int m_cacheFileFd;
+	int m_cacheFileAccess;
+	int m_backingFd;
+	bool m_directIo;
 
 	mtd_info_t m_mtdInfo;
+
+	// destroyed first (in reverse order), their threads use members above,
+	// queued erases have to be finished before final sync
+	std::unique_ptr<SyncPolicy> m_syncPolicy;
+	std::unique_ptr<EraseEngine> m_eraseEngine;
 };
 
 #endif // __LIBNORSIM_H__
@@ -1,6 +1,7 @@
 #ifndef __LOGGER_H__
 #define __LOGGER_H__
 
+#include <atomic>
 #include <cstdarg>
 #include <cstdio>
 #include <mutex>
@@ -33,23 +34,26 @@ public:
 
 	virtual bool isOk() = 0;
 
+	// level is checked before lock is taken, filtered out messages cost no more than call
 	void log(const Loglevel level, const char *format, const bool raw = false, ...) {
+		if (!isEnabled(level))
+			return;
 		std::lock_guard<std::mutex> lg(m_mutex);
 		if (!m_logFormatter)
 			return;
 		va_list args;
 		va_start(args, raw);
-
-		if ((level == Loglevel::ALWAYS) || (level <= m_verbosity)) {
-			vsnprintf(m_printBuffer, LOGGER_PRINTBUFFER_SIZE, format, args);
-			write(m_logFormatter->format(level, m_printBuffer, raw));
-		}
+		vsnprintf(m_printBuffer, LOGGER_PRINTBUFFER_SIZE, format, args);
+		write(m_logFormatter->format(level, m_printBuffer, raw));
 		va_end(args);
 	}
 
+	bool isEnabled(const Loglevel level) {
+		return ((level == Loglevel::ALWAYS) || (level <= m_verbosity.load(std::memory_order_relaxed)));
+	}
+
 	void setVerbosity(Loglevel verbosity) {
-		std::lock_guard<std::mutex> lg(m_mutex);
-		m_verbosity = verbosity;
+		m_verbosity.store(verbosity, std::memory_order_relaxed);
 	}
 
 protected:
@@ -62,7 +66,7 @@ protected:
 	LogFormatter *m_logFormatter;
 
 private:
-	Loglevel m_verbosity = Loglevel::DEBUG;
+	std::atomic<Loglevel> m_verbosity{Loglevel::DEBUG};
 	std::mutex m_mutex;
 };
 
@@ -81,6 +85,22 @@ private:
 	void write(const char *msg) { printf("%s", msg); fflush(stdout); }
 };
 
+// discards all messages
+class LoggerNull : public Logger {
+	friend class LoggerFactory;
+
+public:
+	~LoggerNull() {}
+
+	bool isOk() { return (true); }
+
+private:
+	LoggerNull()
+	 : Logger(NULL) {}
+
+	void write(const char *msg) { (void)msg; }
+};
+
 #ifdef LOGGERFILE_ENABLE
 class LoggerFile : public Logger {
 	friend class LoggerFactory;
@@ -112,6 +132,9 @@ public:
 	static Logger* createLoggerStdio(LogFormatter *formatter) {
 		return (new LoggerStdio(formatter));
 	}
+	static Logger* createLoggerNull() {
+		return (new LoggerNull());
+	}
 #ifdef LOGGERFILE_ENABLE
 	static Logger* createLoggerFile(LogFormatter *formatter, const char *file) {
 		return (new LoggerFile(formatter, file));
@@ -0,0 +1,670 @@
+#include <cerrno>
+#include <cstdlib>
+#include <cstring>
+#include <stdexcept>
+#include <string>
+#include <vector>
+
+#include "NorDevice.h"
+#include "Logger.h"
+#include "Probes.h"
+
+// contents kept in memory, blocks are modified in place
+class NorStorageMemory : public NorStorage {
+public:
+	NorStorageMemory(NorGeometry &geometry)
+	 : m_geometry(geometry) {
+		m_data.reset(new char[m_geometry.getSize()]);
+		memset(m_data.get(), 0xFF, m_geometry.getSize());
+	}
+
+	int read(const unsigned index, const unsigned indexIn, void *buf, size_t count, off_t offset) {
+		(void)index;
+		(void)indexIn;
+		memcpy(buf, &m_data[offset], count);
+		return (count);
+	}
+	char* load(const unsigned index, const unsigned indexIn, size_t count, off_t offset) {
+		(void)indexIn;
+		(void)count;
+		(void)offset;
+		return (&m_data[m_geometry.getBlockOffset(index)]);
+	}
+	bool store(const unsigned index, const char *block, const unsigned indexIn, size_t count, off_t offset) {
+		(void)index;
+		(void)block;
+		(void)indexIn;
+		(void)count;
+		(void)offset;
+		return (true);
+	}
+	char* erase(const unsigned index) { return (&m_data[m_geometry.getBlockOffset(index)]); }
+	bool commit() { return (true); }
+
+private:
+	NorGeometry &m_geometry;
+	std::unique_ptr<char[]> m_data;
+};
+
+NorDevice::NorDevice(const st_nor_config_t &config)
+ : m_geometry((NULL != config.geometry)?(*config.geometry):(NorGeometry(config.size, config.eraseSize))), m_lean(false), m_powered(true), m_powerOps(0), m_cutAt(0),
+   m_logger(config.logger), m_storage(config.storage), m_observer(config.observer) {
+	memset(&m_stats, 0x00, sizeof(m_stats));
+	memset(&m_programTotals, 0x00, sizeof(m_programTotals));
+	if (config.programCheck)
+		m_programStats.reset(new st_program_stats_t[m_geometry.getBlockCount()]());
+
+	if (NULL == m_logger) {
+		m_ownedLogger.reset(LoggerFactory::createLoggerNull());
+		m_logger = m_ownedLogger.get();
+	}
+	if (NULL == m_storage) {
+		m_ownedStorage.reset(new NorStorageMemory(m_geometry));
+		m_storage = m_ownedStorage.get();
+	}
+	m_pageManager.reset(new PageManager(*m_logger, m_geometry, config.seed, config.sharedPages));
+	if (NULL != config.weakPages)
+		m_pageManager->parseWeakPagesEnv(config.weakPages);
+	if (NULL != config.gravePages)
+		m_pageManager->parseGravePagesEnv(config.gravePages);
+	updateEngine();
+}
+
+// defined here, Logger is complete type only in this file
+NorDevice::~NorDevice() {
+}
+
+int NorDevice::read(void *buf, size_t count, off_t offset) {
+	if (!isInBlock(offset, count)) {
+		m_logger->log(Loglevel::WARNING, "Read block exceeds eraseblock boundary");
+		errno = EINVAL;
+		return (-1);
+	}
+	if (m_lean)
+		return (readLean(buf, count, offset));
+	if (!checkPower())
+		return (-1);
+	unsigned index = getBlock(offset);
+	unsigned index_in = offset - getBlockOffset(index);
+	st_page_t &page = getPage(index);
+	int ret;
+
+	notePage(index);
+	page.reads++;
+	m_stats.reads++;
+	PROBE4(pread, index, offset, count, page.reads);
+	if ((E_PAGE_GRAVE != page.type) || (page.reads <= page.limit)) {
+		ret = m_storage->read(index, index_in, buf, count, offset);
+		if ((ret > 0) && hasBitErrors())
+			injectBitErrors(index, buf, ret);
+		return (ret);
+	}
+
+	m_stats.faults++;
+	PROBE5(fault, TRACE_OP_PREAD, index, m_pageManager->getPageBehavior(index), page.reads, page.limit);
+	if (E_BEH_EIO == m_pageManager->getPageBehavior(index)) {
+		m_logger->log(Loglevel::NOTE, "EIO error at page: %lu", false, index);
+		notifyFault(index, TRACE_FAULT_EIO);
+		errno = EIO;
+		return (-1);
+	}
+	ret = m_storage->read(index, index_in, buf, count, offset);
+	notifyFault(index, TRACE_FAULT_RND);
+	if (ret > 0) {
+		unsigned long rnd = m_pageManager->random() % count;
+		char rnd_byte = ((char*)buf)[rnd] ^ rnd;
+		m_logger->log(Loglevel::NOTE, "RND error at page: %lu[%lu], expected: 0x%02X, is 0x%02X", false, index, index_in + rnd, ((char*)buf)[rnd], rnd_byte);
+		((char*)buf)[rnd] = rnd_byte;
+	}
+	if ((ret > 0) && hasBitErrors())
+		injectBitErrors(index, buf, ret);
+	return (ret);
+}
+
+int NorDevice::program(const void *buf, size_t count, off_t offset) {
+	if (!isInBlock(offset, count)) {
+		m_logger->log(Loglevel::WARNING, "Write block exceeds eraseblock boundary");
+		errno = EINVAL;
+		return (-1);
+	}
+	if (m_lean)
+		return (programLean(buf, count, offset));
+	if (!checkPower())
+		return (-1);
+	unsigned index = getBlock(offset);
+	unsigned index_in = offset - getBlockOffset(index);
+	st_page_t &page = getPage(index);
+	int ret = count;
+
+	char *block = m_storage->load(index, index_in, count, offset);
+	if (NULL == block) {
+		m_logger->log(Loglevel::WARNING, "Pre-read failed");
+		errno = EIO;
+		return (-1);
+	}
+	notePage(index);
+	if (m_journal)
+		memcpy(m_journal->addData(index, index_in, count), &block[index_in], count);
+	if (isCutNow()) {
+		// bits being cleared in byte where program stopped are cleared randomly
+		size_t done = m_pageManager->random() % count;
+		m_pageManager->mergeBitMasks(index_in, done, block, static_cast<const char*>(buf));
+		block[index_in + done] &= (static_cast<const char*>(buf)[done] | static_cast<char>(m_pageManager->random()));
+		page.writes++;
+		m_stats.programs++;
+		m_storage->store(index, block, index_in, count, offset);
+		m_logger->log(Loglevel::NOTE, "Power cut during program at page: %u (%lu of %lu bytes done)", false, index, done, count);
+		cutPower();
+		notifyFault(index, TRACE_FAULT_POWER);
+		errno = EIO;
+		return (-1);
+	}
+	if (m_programStats)
+		checkProgram(index, index_in, count, block, static_cast<const char*>(buf));
+	else
+		m_pageManager->mergeBitMasks(index_in, count, block, static_cast<const char*>(buf));
+	page.writes++;
+	m_stats.programs++;
+	PROBE4(pwrite, index, offset, count, page.writes);
+	if (!m_storage->store(index, block, index_in, count, offset)) {
+		errno = EIO;
+		ret = -1;
+	}
+	if (!isPageWorn(page))
+		return (ret);
+
+	m_stats.faults++;
+	PROBE5(fault, TRACE_OP_PWRITE, index, m_pageManager->getPageBehavior(index), page.erases, page.limit);
+	if (E_BEH_EIO == m_pageManager->getPageBehavior(index)) {
+		m_logger->log(Loglevel::NOTE, "EIO error at page: %lu", false, index);
+		notifyFault(index, TRACE_FAULT_EIO);
+		errno = EIO;
+		return (-1);
+	}
+	m_logger->log(Loglevel::NOTE, "RND error at page: %lu", false, index);
+	notifyFault(index, TRACE_FAULT_RND);
+	return (ret);
+}
+
+int NorDevice::unlock(off_t offset, size_t length) {
+	if (!isRangeValid(offset, length)) {
+		errno = EINVAL;
+		return (-1);
+	}
+	return (unlockBlocks(getBlock(offset), getBlocksIn(offset, length)));
+}
+
+int NorDevice::lock(off_t offset, size_t length) {
+	if (!isRangeValid(offset, length)) {
+		errno = EINVAL;
+		return (-1);
+	}
+	return (lockBlocks(getBlock(offset), getBlocksIn(offset, length)));
+}
+
+int NorDevice::erase(off_t offset, size_t length) {
+	if (!isRangeValid(offset, length)) {
+		errno = EINVAL;
+		return (-1);
+	}
+	if (!isUnlocked(getBlock(offset), getBlocksIn(offset, length))) {
+		errno = EPERM;
+		return (-1);
+	}
+	return (eraseBlocks(getBlock(offset), getBlocksIn(offset, length)));
+}
+
+bool NorDevice::isInBlock(off_t offset, size_t count) {
+	if ((offset < 0) || (static_cast<unsigned long>(offset) + count > getSize()))
+		return (false);
+	unsigned index = getBlock(offset);
+	return (offset - getBlockOffset(index) + count <= getBlockSize(index));
+}
+
+bool NorDevice::isRangeValid(off_t offset, size_t length) {
+	if ((offset < 0) ||
+		(0 == length) ||
+		((static_cast<unsigned long>(offset) + length) > getSize()) ||
+		(getBlockOffset(getBlock(offset)) != static_cast<unsigned long>(offset)) ||
+		(getBlockOffset(getBlock(offset + length)) != offset + length)) {
+		m_logger->log(Loglevel::WARNING, "Invalid erase_info_t, start=0x%lX, length=0x%lX",
+			false, (unsigned long)offset, (unsigned long)length);
+		return (false);
+	}
+	return (true);
+}
+
+bool NorDevice::isUnlocked(const unsigned first, const unsigned count) {
+	for (unsigned index = first; index < first + count; ++index) {
+		if (!getPage(index).unlocked) {
+			m_logger->log(Loglevel::WARNING, "Page %ld locked, rejecting erase request", false, index);
+			return (false);
+		}
+	}
+	return (true);
+}
+
+int NorDevice::unlockBlocks(const unsigned first, const unsigned count) {
+	if (!checkPower())
+		return (-1);
+	for (unsigned index = first; index < first + count; ++index) {
+		notePage(index);
+		getPage(index).unlocked = true;
+	}
+	m_stats.unlocks++;
+	return (0);
+}
+
+int NorDevice::lockBlocks(const unsigned first, const unsigned count) {
+	if (!checkPower())
+		return (-1);
+	for (unsigned index = first; index < first + count; ++index) {
+		notePage(index);
+		getPage(index).unlocked = false;
+	}
+	return (0);
+}
+
+int NorDevice::eraseBlocks(const unsigned first, const unsigned count) {
+	if (m_lean)
+		return (eraseLean(first, count));
+	if (!checkPower())
+		return (-1);
+	if (isCutNow())
+		return (tearErase(first, count));
+	return (eraseRange(first, count));
+}
+
+// Blocks erased cleanly are written back together, worn out weak ones
+// get their own dead bits so they are handled one by one afterwards.
+// Erase locks blocks again.
+int NorDevice::eraseRange(const unsigned first, const unsigned count) {
+	int ret = 0;
+	char *block;
+
+	for (unsigned index = first; index < first + count; ++index) {
+		st_page_t &page = getPage(index);
+		notePage(index);
+		page.erases++;
+		page.unlocked = false;
+		m_stats.erases++;
+		PROBE3(erase_block, index, page.erases, isPageWorn(page));
+		if (isPageWorn(page))
+			continue;
+		if (!noteErase(index) || (NULL == (block = m_storage->erase(index))))
+			ret = -1;
+		else
+			memset(block, 0xFF, getBlockSize(index));
+	}
+	if (!m_storage->commit())
+		ret = -1;
+
+	for (unsigned index = first; index < first + count; ++index) {
+		st_page_t &page = getPage(index);
+		if (!isPageWorn(page))
+			continue;
+		m_stats.faults++;
+		PROBE5(fault, TRACE_OP_ERASE, index, m_pageManager->getPageBehavior(index), page.erases, page.limit);
+		block = NULL;
+		if (noteErase(index) && (NULL != (block = m_storage->erase(index)))) {
+			memset(block, 0xFF, getBlockSize(index));
+			m_pageManager->setBitMask(index, block);
+		}
+		if ((NULL == block) || !m_storage->commit())
+			ret = -1;
+		if (E_BEH_EIO == m_pageManager->getPageBehavior(index)) {
+			m_logger->log(Loglevel::NOTE, "EIO error at page: %lu", false, index);
+			notifyFault(index, TRACE_FAULT_EIO);
+			ret = -1;
+		} else {
+			m_logger->log(Loglevel::NOTE, "RND error at page: %lu", false, index);
+			notifyFault(index, TRACE_FAULT_RND);
+		}
+	}
+
+	if (ret < 0)
+		errno = EIO;
+	return (ret);
+}
+
+int NorDevice::age(off_t offset, size_t length, const unsigned long erases, const unsigned long programs) {
+	if (!isRangeValid(offset, length)) {
+		errno = EINVAL;
+		return (-1);
+	}
+	return (ageBlocks(getBlock(offset), getBlocksIn(offset, length), erases, programs));
+}
+
+// whole spec is checked before any block is aged
+int NorDevice::parseAging(const char *spec, const bool apply) {
+	struct st_age_node_t {
+		unsigned long first;
+		unsigned long last;
+		unsigned long erases;
+		unsigned long programs;
+	};
+	std::vector<st_age_node_t> nodes;
+	const char *cur = spec;
+	const char *end_node;
+	int count = 0;
+
+	while (NULL != (end_node = strchr(cur, PARSE_NODE_DELIM))) {
+		std::string node(cur, end_node - cur);
+		const char *str = node.c_str();
+		char *end;
+		st_age_node_t age = {0, getPageCount() - 1, 0, 0};
+
+		if (PARSE_SPAN_ALL == str[0]) {
+			end = const_cast<char*>(&str[1]);
+		} else {
+			age.first = age.last = strtoul(str, &end, 10);
+			if (end == str)
+				goto err_syntax;
+			if (PARSE_RANGE_DELIM == *end)
+				age.last = strtoul(end + 1, &end, 10);
+		}
+		if (PARSE_PROP_DELIM != *end)
+			goto err_syntax;
+		str = end + 1;
+		age.erases = strtoul(str, &end, 10);
+		if (end == str)
+			goto err_syntax;
+		if (PARSE_PROP_DELIM == *end) {
+			str = end + 1;
+			age.programs = strtoul(str, &end, 10);
+			if (end == str)
+				goto err_syntax;
+		}
+		if (0 != *end)
+			goto err_syntax;
+		if ((age.first > age.last) || (age.last >= getPageCount())) {
+			m_logger->log(Loglevel::ERROR, "\t(A)\ttrying to age non existing page (pages=%lu-%lu, count=%u)", false,
+				age.first, age.last, getPageCount());
+			return (-1);
+		}
+		nodes.push_back(age);
+		cur = end_node + 1;
+		continue;
+
+err_syntax:
+		m_logger->log(Loglevel::ERROR, "\t(A)\tinvalid aging node: \"%s\"", false, node.c_str());
+		return (-1);
+	}
+
+	for (const st_age_node_t &age : nodes) {
+		m_logger->log(Loglevel::DEBUG, "\t(A)\tpages=%lu-%lu\terases=%lu\tprograms=%lu", false,
+			age.first, age.last, age.erases, age.programs);
+		if (apply)
+			ageBlocks(age.first, age.last - age.first + 1, age.erases, age.programs);
+		count += age.last - age.first + 1;
+	}
+	return (count);
+}
+
+// dead bits are stuck at 0, erased state of worn block contains them as well
+int NorDevice::ageBlocks(const unsigned first, const unsigned count, const unsigned long erases, const unsigned long programs) {
+	int ret = 0;
+	char *block;
+
+	for (unsigned index = first; index < first + count; ++index) {
+		notePage(index);
+		if (!m_pageManager->agePage(index, erases, programs))
+			continue;
+		m_logger->log(Loglevel::NOTE, "Page %u worn out by aging (erases=%lu, limit=%u)", false,
+			index, getPage(index).erases, getPage(index).limit);
+		unsigned long size = getBlockSize(index);
+		block = m_storage->load(index, 0, size, getBlockOffset(index));
+		if (NULL == block) {
+			ret = -1;
+			continue;
+		}
+		if (m_journal)
+			memcpy(m_journal->addData(index, 0, size), block, size);
+		m_pageManager->setBitMask(index, block);
+		if (!m_storage->store(index, block, 0, size, getBlockOffset(index)))
+			ret = -1;
+	}
+	updateEngine();
+	if (ret < 0)
+		errno = EIO;
+	return (ret);
+}
+
+void NorDevice::noteRead(const unsigned index, off_t offset, size_t count) {
+	st_page_t &page = getPage(index);
+	notePage(index);
+	page.reads++;
+	m_stats.reads++;
+	PROBE4(pread, index, offset, count, page.reads);
+}
+
+void NorDevice::armPowerCut(const unsigned long first, const unsigned long last) {
+	m_powerOps = 0;
+	m_cutAt = first;
+	if (first < last)
+		m_cutAt += m_pageManager->random() % (last - first + 1);
+	m_logger->log(Loglevel::INFO, "Set power cut at operation: %lu", false, m_cutAt);
+	if (0 == m_cutAt)
+		cutPower();
+	updateEngine();
+}
+
+void NorDevice::cutPower() {
+	m_powered = false;
+	m_cutAt = 0;
+	m_stats.powerCuts++;
+	m_logger->log(Loglevel::NOTE, "Power cut");
+	updateEngine();
+}
+
+// contents of device are kept, state of blocks (lock) isn't
+void NorDevice::restorePower() {
+	for (unsigned index = 0; index < getPageCount(); ++index) {
+		notePage(index);
+		getPage(index).unlocked = false;
+	}
+	m_powered = true;
+	m_logger->log(Loglevel::NOTE, "Power restored");
+	updateEngine();
+}
+
+unsigned long NorDevice::checkpoint() {
+	if (!m_journal) {
+		m_journal.reset(new UndoJournal(getPageCount()));
+		updateEngine();
+	}
+	return (m_journal->getCheckpoint());
+}
+
+// contents are restored through storage, same way they were changed
+int NorDevice::rollback(const unsigned long checkpoint) {
+	const st_undo_record_t *rec;
+	int ret = 0;
+
+	if ((!m_journal) || (checkpoint > m_journal->getRecordCount())) {
+		m_logger->log(Loglevel::WARNING, "Invalid checkpoint: %lu", false, checkpoint);
+		errno = EINVAL;
+		return (-1);
+	}
+	while (m_journal->getRecordCount() > checkpoint) {
+		rec = m_journal->getLast();
+		if (0 == rec->length) {
+			m_pageManager->restorePage(rec->index, rec->page);
+		} else {
+			off_t offset = getBlockOffset(rec->index) + rec->offset;
+			char *block = m_storage->load(rec->index, rec->offset, rec->length, offset);
+			if (NULL != block)
+				memcpy(&block[rec->offset], &rec[1], rec->length);
+			if ((NULL == block) || !m_storage->store(rec->index, block, rec->offset, rec->length, offset))
+				ret = -1;
+		}
+		m_journal->dropLast();
+	}
+	m_journal->startEpoch();
+	m_stats.rollbacks++;
+	m_logger->log(Loglevel::NOTE, "Rolled back to checkpoint: %lu", false, checkpoint);
+
+	if (ret < 0)
+		errno = EIO;
+	return (ret);
+}
+
+bool NorDevice::replaceFaults(const char *weakPages, const char *gravePages) {
+	bool ret = m_pageManager->replaceFaults(weakPages, gravePages);
+	updateEngine();
+	return (ret);
+}
+
+bool NorDevice::setBitErrorRate(const char *spec) {
+	bool ret = m_pageManager->parseBitErrorRate(spec);
+	updateEngine();
+	return (ret);
+}
+
+void NorDevice::updateEngine() {
+	bool lean = (!m_pageManager->hasFaults()) && (!hasBitErrors()) && (!m_programStats) &&
+		(!m_journal) && m_powered && (0 == m_cutAt);
+	if (lean != m_lean)
+		m_logger->log(Loglevel::DEBUG, "Using %s engine", false, (lean)?("lean"):("fault"));
+	m_lean = lean;
+}
+
+// Lean engine: page can't fault and nothing has to be recorded before change,
+// so operation is done right away (checks of range and locks are done by caller).
+int NorDevice::readLean(void *buf, size_t count, off_t offset) {
+	unsigned index = getBlock(offset);
+	st_page_t &page = getPage(index);
+
+	page.reads++;
+	m_stats.reads++;
+	PROBE4(pread, index, offset, count, page.reads);
+	return (m_storage->read(index, offset - getBlockOffset(index), buf, count, offset));
+}
+
+int NorDevice::programLean(const void *buf, size_t count, off_t offset) {
+	unsigned index = getBlock(offset);
+	unsigned index_in = offset - getBlockOffset(index);
+	st_page_t &page = getPage(index);
+
+	char *block = m_storage->load(index, index_in, count, offset);
+	if (NULL == block) {
+		m_logger->log(Loglevel::WARNING, "Pre-read failed");
+		errno = EIO;
+		return (-1);
+	}
+	m_pageManager->mergeBitMasks(index_in, count, block, static_cast<const char*>(buf));
+	page.writes++;
+	m_stats.programs++;
+	PROBE4(pwrite, index, offset, count, page.writes);
+	if (!m_storage->store(index, block, index_in, count, offset)) {
+		errno = EIO;
+		return (-1);
+	}
+	return (count);
+}
+
+int NorDevice::eraseLean(const unsigned first, const unsigned count) {
+	int ret = 0;
+	char *block;
+
+	for (unsigned index = first; index < first + count; ++index) {
+		st_page_t &page = getPage(index);
+		page.erases++;
+		page.unlocked = false;
+		m_stats.erases++;
+		PROBE3(erase_block, index, page.erases, false);
+		if (NULL == (block = m_storage->erase(index)))
+			ret = -1;
+		else
+			memset(block, 0xFF, getBlockSize(index));
+	}
+	if (!m_storage->commit())
+		ret = -1;
+	if (ret < 0)
+		errno = EIO;
+	return (ret);
+}
+
+bool NorDevice::checkPower() {
+	if (m_powered)
+		return (true);
+	m_logger->log(Loglevel::NOTE, "No power, rejecting operation");
+	errno = EIO;
+	return (false);
+}
+
+bool NorDevice::isCutNow() {
+	return ((0 != m_cutAt) && (++m_powerOps == m_cutAt));
+}
+
+// Blocks before the one being erased when power is cut are erased fully,
+// following ones aren't touched.
+int NorDevice::tearErase(const unsigned first, const unsigned count) {
+	unsigned index = first + m_pageManager->random() % count;
+	unsigned long size = getBlockSize(index);
+	unsigned long done = m_pageManager->random() % size;
+	off_t offset = getBlockOffset(index);
+	st_page_t &page = getPage(index);
+
+	if (index > first)
+		eraseRange(first, index - first);
+	notePage(index);
+	page.erases++;
+	page.unlocked = false;
+	m_stats.erases++;
+	PROBE3(erase_block, index, page.erases, isPageWorn(page));
+	char *block = m_storage->load(index, 0, size, offset);
+	if (NULL != block) {
+		if (m_journal)
+			memcpy(m_journal->addData(index, 0, size), block, size);
+		memset(block, 0xFF, done);
+		block[done] |= static_cast<char>(m_pageManager->random());
+		m_storage->store(index, block, 0, size, offset);
+	}
+	m_logger->log(Loglevel::NOTE, "Power cut during erase at page: %u (%lu of %lu bytes done)", false, index, done, size);
+	cutPower();
+	notifyFault(index, TRACE_FAULT_POWER);
+	errno = EIO;
+	return (-1);
+}
+
+bool NorDevice::noteErase(const unsigned index) {
+	if (!m_journal)
+		return (true);
+	unsigned long size = getBlockSize(index);
+	char *data = m_journal->addData(index, 0, size);
+	return (static_cast<ssize_t>(size) == m_storage->read(index, 0, data, size, getBlockOffset(index)));
+}
+
+void NorDevice::injectBitErrors(const unsigned index, void *buf, size_t count) {
+	unsigned long flipped = m_pageManager->flipBits(index, static_cast<char*>(buf), count);
+	if (0 == flipped)
+		return;
+	m_stats.bitErrorReads++;
+	m_stats.bitErrors += flipped;
+	m_logger->log(Loglevel::NOTE, "Bit errors at page: %u (%lu bits)", false, index, flipped);
+	notifyFault(index, TRACE_FAULT_RND);
+}
+
+void NorDevice::checkProgram(const unsigned index, const unsigned indexIn, size_t count, char *block, const char *buf) {
+	st_program_check_t check;
+	memset(&check, 0x00, sizeof(check));
+	m_pageManager->mergeBitMasks(indexIn, count, block, buf, check);
+
+	st_program_stats_t *stats[] = { &m_programStats[index], &m_programTotals };
+	for (st_program_stats_t *st : stats) {
+		st->programs++;
+		st->bytes += count;
+		st->programmedBits += check.programmedBits;
+		st->identicalBytes += check.identicalBytes;
+		st->illegalBits += check.illegalBits;
+		st->violations += (0 != check.illegalBits);
+	}
+	if (0 != check.illegalBits)
+		m_logger->log(Loglevel::NOTE, "Program of bits 0->1 at page: %u[%u] (%lu bits ignored)", false, index, indexIn, check.illegalBits);
+}
+
+void NorDevice::notifyFault(const unsigned index, const e_trace_fault_t fault) {
+	if (NULL != m_observer)
+		m_observer->onFault(index, fault);
+}
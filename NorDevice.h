@@ -0,0 +1,211 @@
+#ifndef __NORDEVICE_H__
+#define __NORDEVICE_H__
+
+// Simulated NOR device usable directly by programs (link with libnorsim-core,
+// no interposition involved). Device has no global state, any number of them
+// can be created, but single device isn't thread-safe (callers serialize).
+// Preloaded libnorsim is an adapter of one device to intercepted calls.
+
+#include <cstddef>
+#include <memory>
+
+#include <sys/types.h>
+
+#include "NorGeometry.h"
+#include "PageManager.h"
+#include "TraceFormat.h"
+#include "UndoJournal.h"
+
+class Logger;
+
+// Contents of device, addressed by eraseblocks. Modified block is loaded (only
+// given part of it has to be valid), changed in place and stored.
+class NorStorage {
+public:
+	virtual ~NorStorage() {}
+
+	virtual int read(const unsigned index, const unsigned indexIn, void *buf, size_t count, off_t offset) = 0;
+	virtual char* load(const unsigned index, const unsigned indexIn, size_t count, off_t offset) = 0;
+	virtual bool store(const unsigned index, const char *block, const unsigned indexIn, size_t count, off_t offset) = 0;
+	// block filled with erased state by device, written by commit() (may be batched)
+	virtual char* erase(const unsigned index) = 0;
+	virtual bool commit() = 0;
+};
+
+class NorDeviceObserver {
+public:
+	virtual ~NorDeviceObserver() {}
+
+	// fault injected by currently performed operation
+	virtual void onFault(const unsigned index, const e_trace_fault_t fault) = 0;
+};
+
+struct st_nor_config_t {
+	unsigned long size;          // bytes, multiple of erase size
+	unsigned long eraseSize;     // bytes
+	const NorGeometry *geometry; // NULL - uniform one given by size and erase size (ignored otherwise)
+	const char *weakPages;       // NS_WEAK_PAGES format, NULL - none
+	const char *gravePages;      // NS_GRAVE_PAGES format, NULL - none
+	unsigned seed;               // limits, dead bits and randomized data (1 - like rand() not seeded)
+	NorStorage *storage;         // NULL - contents are kept in memory by device
+	NorDeviceObserver *observer; // NULL - none
+	st_page_t *sharedPages;      // NULL - page states are allocated by device
+	Logger *logger;              // NULL - messages are discarded
+	bool programCheck;           // count programmed bits and program rule violations per page
+};
+
+struct st_nor_stats_t {
+	unsigned long reads;
+	unsigned long programs;
+	unsigned long unlocks;
+	unsigned long erases;
+	unsigned long faults;
+	unsigned long powerCuts;
+	unsigned long rollbacks;
+	unsigned long bitErrorReads;
+	unsigned long bitErrors;
+};
+
+// bits each program changes and its attempts to set bits (0->1), which are
+// ignored like by real device
+struct st_program_stats_t {
+	unsigned long programs;
+	unsigned long bytes;
+	unsigned long programmedBits;
+	unsigned long identicalBytes;
+	unsigned long illegalBits;
+	unsigned long violations;      // programs with illegal bits
+};
+
+class NorDevice {
+public:
+	// throws std::runtime_error for invalid geometry or when memory can't be allocated
+	NorDevice(const st_nor_config_t &config);
+	~NorDevice();
+
+	unsigned long getSize() { return (m_geometry.getSize()); }
+	// largest eraseblock
+	unsigned long getEraseSize() { return (m_geometry.getEraseSize()); }
+	NorGeometry& getGeometry() { return (m_geometry); }
+	unsigned getBlock(const unsigned long offset) { return (m_geometry.getBlock(offset)); }
+	unsigned long getBlockOffset(const unsigned index) { return (m_geometry.getBlockOffset(index)); }
+	unsigned long getBlockSize(const unsigned index) { return (m_geometry.getBlockSize(index)); }
+	unsigned getPageCount() { return (m_pageManager->getPageCount()); }
+	st_page_t& getPage(const unsigned index) { return (m_pageManager->getPage(index)); }
+	PageManager& getPageManager() { return (*m_pageManager.get()); }
+	const st_nor_stats_t& getStats() { return (m_stats); }
+	// NULL when program check isn't enabled
+	const st_program_stats_t* getProgramStats(const unsigned index) { return ((m_programStats)?(&m_programStats[index]):(NULL)); }
+	const st_program_stats_t& getProgramTotals() { return (m_programTotals); }
+	Logger& getLogger() { return (*m_logger); }
+
+	// Operations return -1 with errno set on failure: EINVAL (invalid range),
+	// EPERM (erase of locked block) or EIO (fault, storage failure or no power).
+	// Read and program must stay within single eraseblock, program clears
+	// bits only. Unlock, lock and erase work on whole eraseblocks.
+	int read(void *buf, size_t count, off_t offset);
+	int program(const void *buf, size_t count, off_t offset);
+	int unlock(off_t offset, size_t length);
+	int lock(off_t offset, size_t length);
+	int erase(off_t offset, size_t length);
+	bool isLocked(const unsigned index) { return (!getPage(index).unlocked); }
+	// Device without faults, bit errors, program check, journal and power loss
+	// (armed or done) runs lean engine: same contents and counters, without
+	// their checks and logging. It's selected again whenever any of them changes
+	// (clearing last fault included, behaviors don't matter).
+	bool isLean() { return (m_lean); }
+
+	// fault control, same formats as environment of preloaded library
+	void parseWeakPages(const char *spec) { m_pageManager->parseWeakPagesEnv(spec); updateEngine(); }
+	void parseGravePages(const char *spec) { m_pageManager->parseGravePagesEnv(spec); updateEngine(); }
+	void setPageFault(const unsigned index, const e_page_type_t type, const unsigned limit, const e_beh_t behavior = E_BEH_DEFAULT) {
+		m_pageManager->setPageFault(index, type, limit, behavior);
+		updateEngine();
+	}
+	void clearPageFault(const unsigned index) { m_pageManager->clearPageFault(index); updateEngine(); }
+	void setBehavior(const e_page_type_t type, const e_beh_t behavior) { m_pageManager->setBehavior(type, behavior); }
+	// all faults are replaced at once (NULL - none of type), nothing changes when spec is invalid
+	bool replaceFaults(const char *weakPages, const char *gravePages);
+
+	// Wear aging adds erase and program cycles at once (no I/O is done for
+	// them), blocks worn out by it get their dead bits in contents. Blocks
+	// without fault get failure point from wear curve, if it's set.
+	bool setWearCurve(const char *spec) { return (m_pageManager->parseWearCurve(spec)); }
+	// bits of read data are flipped with rate growing with erases and reads of page
+	bool setBitErrorRate(const char *spec);
+	bool hasBitErrors() { return (m_pageManager->hasBitErrorRate()); }
+	int age(off_t offset, size_t length, const unsigned long erases, const unsigned long programs);
+	// "<pages>,<erases>[,<programs>];" nodes, pages: <page>, <first>-<last> or *;
+	// returns number of aged blocks (only counted when not applied) or -1 (nothing is aged then)
+	int parseAging(const char *spec, const bool apply = true);
+
+	// Power loss: program or erase being cut is left partially done (prefix
+	// of its range, with random bits of byte where it stopped) and fails. All
+	// operations fail then until power is restored, which locks all blocks.
+	// Cut is armed to program or erase drawn from [first, last] counted from
+	// now (1 - next one, 0 - cut right away).
+	void armPowerCut(const unsigned long first, const unsigned long last);
+	void cutPower();
+	void restorePower();
+	bool isPowered() { return (m_powered); }
+
+	// Undo journal is kept from first checkpoint, rollback restores contents and
+	// page states of checkpoint in time proportional to changes done since then.
+	// Checkpoints taken after the one rolled back to are invalid afterwards.
+	unsigned long checkpoint();
+	int rollback(const unsigned long checkpoint);
+	void dropCheckpoints() { m_journal.reset(); updateEngine(); }
+	UndoJournal* getJournal() { return (m_journal.get()); }
+
+	// parts of operations for adapters checking ranges and locks themselves
+	bool isInBlock(off_t offset, size_t count);
+	bool isRangeValid(off_t offset, size_t length);
+	// number of blocks of valid range
+	unsigned getBlocksIn(off_t offset, size_t length) { return (getBlock(offset + length) - getBlock(offset)); }
+	bool isUnlocked(const unsigned first, const unsigned count);
+	int unlockBlocks(const unsigned first, const unsigned count);
+	int lockBlocks(const unsigned first, const unsigned count);
+	int eraseBlocks(const unsigned first, const unsigned count);
+	int ageBlocks(const unsigned first, const unsigned count, const unsigned long erases, const unsigned long programs);
+	// read of block which can't fault was done without device
+	void noteRead(const unsigned index, off_t offset, size_t count);
+
+private:
+	void updateEngine();
+	int readLean(void *buf, size_t count, off_t offset);
+	int programLean(const void *buf, size_t count, off_t offset);
+	int eraseLean(const unsigned first, const unsigned count);
+
+	void notifyFault(const unsigned index, const e_trace_fault_t fault);
+	bool checkPower();
+	bool isCutNow();
+	int eraseRange(const unsigned first, const unsigned count);
+	int tearErase(const unsigned first, const unsigned count);
+	// page state and contents are journaled before they are changed
+	void notePage(const unsigned index) { if (m_journal) m_journal->notePage(index, getPage(index)); }
+	bool noteErase(const unsigned index);
+	void injectBitErrors(const unsigned index, void *buf, size_t count);
+	void checkProgram(const unsigned index, const unsigned indexIn, size_t count, char *block, const char *buf);
+	bool isPageWorn(const st_page_t &page) { return ((E_PAGE_WEAK == page.type) && (page.erases > page.limit)); }
+
+	NorGeometry m_geometry;
+	st_nor_stats_t m_stats;
+	st_program_stats_t m_programTotals;
+	std::unique_ptr<st_program_stats_t[]> m_programStats;
+
+	bool m_lean;
+	bool m_powered;
+	unsigned long m_powerOps;
+	unsigned long m_cutAt;
+
+	std::unique_ptr<Logger> m_ownedLogger;
+	std::unique_ptr<NorStorage> m_ownedStorage;
+	std::unique_ptr<PageManager> m_pageManager;
+	std::unique_ptr<UndoJournal> m_journal;
+
+	Logger *m_logger;
+	NorStorage *m_storage;
+	NorDeviceObserver *m_observer;
+};
+
+#endif // __NORDEVICE_H__
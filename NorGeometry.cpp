@@ -0,0 +1,58 @@
+#include <stdexcept>
+
+#include "NorGeometry.h"
+
+static unsigned long gcd(unsigned long a, unsigned long b) {
+	while (0 != b) {
+		unsigned long t = a % b;
+		a = b;
+		b = t;
+	}
+	return (a);
+}
+
+NorGeometry::NorGeometry(const unsigned long size, const unsigned long eraseSize)
+ : m_size(size), m_eraseSize(eraseSize), m_unit(eraseSize), m_blocks(0) {
+	if ((0 == m_eraseSize) || (0 == m_size) || (0 != (m_size % m_eraseSize)))
+		throw std::runtime_error("Device size must be non-zero multiple of erase size");
+	m_blocks = m_size / m_eraseSize;
+}
+
+// adjacent regions of same erase size are merged, single one is uniform device
+NorGeometry::NorGeometry(const std::vector<st_erase_region_t> &regions)
+ : m_size(0), m_eraseSize(0), m_unit(0), m_blocks(0) {
+	for (const st_erase_region_t &region : regions) {
+		if ((0 == region.eraseSize) || (0 == region.blocks))
+			throw std::runtime_error("Erase region must have non-zero erase size and block count");
+		if ((!m_regions.empty()) && (m_regions.back().eraseSize == region.eraseSize)) {
+			m_regions.back().blocks += region.blocks;
+		} else {
+			m_regions.push_back(region);
+			m_regions.back().offset = m_size;
+		}
+		m_size += region.eraseSize * region.blocks;
+		m_blocks += region.blocks;
+		if (region.eraseSize > m_eraseSize)
+			m_eraseSize = region.eraseSize;
+		m_unit = gcd(m_unit, region.eraseSize);
+	}
+	if (m_regions.empty())
+		throw std::runtime_error("Device must have at least one erase region");
+	if (1 == m_regions.size()) {
+		m_regions.clear();
+		return;
+	}
+
+	m_offsets.reserve(m_blocks + 1);
+	m_lookup.reserve(m_size / m_unit);
+	for (const st_erase_region_t &region : m_regions) {
+		for (unsigned i = 0; i < region.blocks; ++i) {
+			m_lookup.insert(m_lookup.end(), region.eraseSize / m_unit, m_offsets.size());
+			m_offsets.push_back(region.offset + i * region.eraseSize);
+		}
+	}
+	m_offsets.push_back(m_size);
+}
+
+NorGeometry::~NorGeometry() {
+}
@@ -0,0 +1,58 @@
+#ifndef __NORGEOMETRY_H__
+#define __NORGEOMETRY_H__
+
+#include <vector>
+
+// eraseblocks of same size following each other (like MTD erase region),
+// offset is set by geometry
+struct st_erase_region_t {
+	unsigned long offset;
+	unsigned long eraseSize;
+	unsigned blocks;
+};
+
+// Layout of eraseblocks of device, uniform or made of regions of blocks of
+// different sizes (like boot sectors). Block containing offset is found in
+// constant time: by division when device is uniform, otherwise by table
+// indexed by offset in units of greatest common divisor of erase sizes.
+class NorGeometry {
+public:
+	// throws std::runtime_error for invalid geometry
+	NorGeometry(const unsigned long size, const unsigned long eraseSize);
+	NorGeometry(const std::vector<st_erase_region_t> &regions);
+	~NorGeometry();
+
+	unsigned long getSize() { return (m_size); }
+	unsigned getBlockCount() { return (m_blocks); }
+	// largest one (erase size of uniform device)
+	unsigned long getEraseSize() { return (m_eraseSize); }
+	bool isUniform() { return (m_regions.empty()); }
+	// empty for uniform device
+	const std::vector<st_erase_region_t>& getRegions() { return (m_regions); }
+
+	// offset beyond device gives index not below block count
+	unsigned getBlock(const unsigned long offset) {
+		if (isUniform())
+			return (offset / m_eraseSize);
+		return ((offset < m_size)?(m_lookup[offset / m_unit]):(m_blocks));
+	}
+	// block count is accepted (end of device)
+	unsigned long getBlockOffset(const unsigned index) {
+		return ((isUniform())?(static_cast<unsigned long>(index) * m_eraseSize):(m_offsets[index]));
+	}
+	unsigned long getBlockSize(const unsigned index) {
+		return ((isUniform())?(m_eraseSize):(m_offsets[index + 1] - m_offsets[index]));
+	}
+
+private:
+	unsigned long m_size;
+	unsigned long m_eraseSize;
+	unsigned long m_unit;
+	unsigned m_blocks;
+
+	std::vector<st_erase_region_t> m_regions;
+	std::vector<unsigned long> m_offsets;
+	std::vector<unsigned> m_lookup;
+};
+
+#endif // __NORGEOMETRY_H__
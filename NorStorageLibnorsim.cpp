@@ -0,0 +1,77 @@
+#include <cstring>
+
+#include "NorStorageLibnorsim.h"
+#include "Libnorsim.h"
+
+int NorStorageLibnorsim::read(const unsigned index, const unsigned indexIn, void *buf, size_t count, off_t offset) {
+	PhaseTimer pt(m_libnorsim.getLatencyStats(), E_LAT_PHASE_IO);
+	BlockCache *cache = m_libnorsim.getBlockCache();
+	if (NULL == cache)
+		return (m_libnorsim.getBackingIo().read(m_libnorsim.getBackingFd(), buf, count, offset));
+
+	char *block = cache->acquire(index);
+	if (NULL == block)
+		return (-1);
+	memcpy(buf, &block[indexIn], count);
+	return (count);
+}
+
+char* NorStorageLibnorsim::load(const unsigned index, const unsigned indexIn, size_t count, off_t offset) {
+	char *block;
+	{
+		PhaseTimer pt(m_libnorsim.getLatencyStats(), E_LAT_PHASE_IO);
+		BlockCache *cache = m_libnorsim.getBlockCache();
+		if (NULL != cache) {
+			block = cache->acquire(index);
+		} else {
+			block = m_libnorsim.getPageBuffer();
+			if (static_cast<ssize_t>(count) != m_libnorsim.getBackingIo().read(m_libnorsim.getBackingFd(), &block[indexIn], count, offset))
+				block = NULL;
+		}
+	}
+	if (NULL != m_libnorsim.getLatencyStats())
+		m_mergeStart = LatencyStats::now();
+	return (block);
+}
+
+bool NorStorageLibnorsim::store(const unsigned index, const char *block, const unsigned indexIn, size_t count, off_t offset) {
+	if (NULL != m_libnorsim.getLatencyStats())
+		m_libnorsim.getLatencyStats()->recordPhase(E_LAT_PHASE_MERGE, m_mergeStart);
+	PhaseTimer pt(m_libnorsim.getLatencyStats(), E_LAT_PHASE_IO);
+	BlockCache *cache = m_libnorsim.getBlockCache();
+	if (NULL != cache) {
+		cache->setDirty(index);
+		return (true);
+	}
+	return (static_cast<ssize_t>(count) == m_libnorsim.getBackingIo().write(m_libnorsim.getBackingFd(), &block[indexIn], count, offset));
+}
+
+// without block cache all blocks are erased in page buffer, their writes are queued until commit()
+char* NorStorageLibnorsim::erase(const unsigned index) {
+	BlockCache *cache = m_libnorsim.getBlockCache();
+	char *block;
+	if (NULL != cache) {
+		PhaseTimer pt(m_libnorsim.getLatencyStats(), E_LAT_PHASE_IO);
+		if (NULL == (block = cache->acquire(index, false)))
+			return (NULL);
+		cache->setDirty(index);
+	} else {
+		block = m_libnorsim.getPageBuffer();
+		m_libnorsim.getBackingIo().queueWrite(m_libnorsim.getBackingFd(), block, m_libnorsim.getGeometry().getBlockSize(index),
+			m_libnorsim.getGeometry().getBlockOffset(index));
+	}
+	return (block);
+}
+
+bool NorStorageLibnorsim::commit() {
+	PhaseTimer pt(m_libnorsim.getLatencyStats(), E_LAT_PHASE_IO);
+	return (m_libnorsim.getBackingIo().submit());
+}
+
+void NorStorageLibnorsim::onFault(const unsigned index, const e_trace_fault_t fault) {
+	(void)index;
+	PhaseTimer pt(m_libnorsim.getLatencyStats(), E_LAT_PHASE_FAULT);
+	TraceRecorder *trace = m_libnorsim.getTraceRecorder();
+	if (NULL != trace)
+		trace->setFault(fault);
+}
@@ -0,0 +1,32 @@
+#ifndef __NORSTORAGELIBNORSIM_H__
+#define __NORSTORAGELIBNORSIM_H__
+
+#include <cstdint>
+
+#include "NorDevice.h"
+
+class Libnorsim;
+
+// Contents of device kept in cache file, accessed through block cache (when
+// enabled) or backing I/O; faults are attached to trace records
+class NorStorageLibnorsim : public NorStorage, public NorDeviceObserver {
+public:
+	NorStorageLibnorsim(Libnorsim &libnorsim)
+	 : m_mergeStart(0), m_libnorsim(libnorsim) {}
+
+	int read(const unsigned index, const unsigned indexIn, void *buf, size_t count, off_t offset);
+	char* load(const unsigned index, const unsigned indexIn, size_t count, off_t offset);
+	bool store(const unsigned index, const char *block, const unsigned indexIn, size_t count, off_t offset);
+	char* erase(const unsigned index);
+	bool commit();
+
+	void onFault(const unsigned index, const e_trace_fault_t fault);
+
+private:
+	// loaded block is merged by device until it's stored
+	uint64_t m_mergeStart;
+
+	Libnorsim &m_libnorsim;
+};
+
+#endif // __NORSTORAGELIBNORSIM_H__
@@ -1,15 +1,29 @@
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
 #include <cstring>
+#include <stdexcept>
+#include <string>
+
+#include <sys/mman.h>
+#include <sys/stat.h>
 
 #include "PageManager.h"
-#include "Libnorsim.h"
 #include "Logger.h"
 
-PageManager::PageManager(Libnorsim &libnorsim, const unsigned pageCount)
- : m_pageCount(pageCount), m_libnorsim(libnorsim) {
-	m_libnorsim.getLogger().log(Loglevel::INFO, "Set page count: %lu", false, m_pageCount);
-	m_pages.reset(new st_page_t[m_pageCount]);
-	if (!m_pages)
+PageManager::PageManager(Logger &logger, NorGeometry &geometry, const unsigned seed, st_page_t *sharedPages)
+ : m_weakPages(0), m_gravePages(0), m_pageCount(geometry.getBlockCount()), m_geometry(geometry),
+   m_behaviorWeak(E_BEH_EIO), m_behaviorGrave(E_BEH_EIO), m_faultyPages(0), m_wearCurveSet(false), m_rberSet(false), m_pages(sharedPages), m_logger(logger) {
+	memset(&m_wearCurve, 0x00, sizeof(m_wearCurve));
+	memset(&m_random, 0x00, sizeof(m_random));
+	initstate_r(seed, m_randomState, sizeof(m_randomState), &m_random);
+	m_logger.log(Loglevel::INFO, "Set page count: %lu", false, m_pageCount);
+	if (NULL != m_pages)
+		return;
+	m_ownedPages.reset(new st_page_t[m_pageCount]);
+	if (!m_ownedPages)
 		throw std::runtime_error("Couldn't allocate memory for page information structures");
+	m_pages = m_ownedPages.get();
 	for (unsigned i = 0; i < m_pageCount; ++i) {
 		m_pages[i].reads = 0;
 		m_pages[i].writes = 0;
@@ -17,6 +31,7 @@ PageManager::PageManager(Libnorsim &libnorsim, const unsigned pageCount)
 		m_pages[i].limit = 0;
 		m_pages[i].type = E_PAGE_NORMAL;
 		m_pages[i].unlocked = false;
+		m_pages[i].behavior = E_BEH_DEFAULT;
 	}
 }
 
@@ -28,11 +43,125 @@ void PageManager::parseGravePagesEnv(const char *env) {
 	m_gravePages = parsePageType(env, "grave", &m_behaviorGrave, E_PAGE_GRAVE);
 }
 
-void PageManager::setBitMask(const unsigned index, char *buffer) {
-	std::set<std::tuple<unsigned, unsigned>>::iterator it;
-	for (it = m_pages[index].deadBits.begin(); it != m_pages[index].deadBits.end(); ++it) {
-		buffer[std::get<0>(*it)] = ~(1 << std::get<1>(*it));
+void PageManager::setFaultSummary(const int weakPages, const int gravePages, const e_beh_t behaviorWeak, const e_beh_t behaviorGrave) {
+	m_weakPages = weakPages;
+	m_gravePages = gravePages;
+	m_behaviorWeak = behaviorWeak;
+	m_behaviorGrave = behaviorGrave;
+}
+
+void PageManager::setBehavior(const e_page_type_t type, const e_beh_t behavior) {
+	if (E_PAGE_WEAK == type)
+		m_behaviorWeak = behavior;
+	else if (E_PAGE_GRAVE == type)
+		m_behaviorGrave = behavior;
+}
+
+void PageManager::clearPageFault(const unsigned index) {
+	setPageType(index, E_PAGE_NORMAL, 0);
+}
+
+bool PageManager::parseWearCurve(const char *str) {
+	if (!parseLimitSpec(str, &m_wearCurve)) {
+		m_logger.log(Loglevel::ERROR, "Invalid wear curve: \"%s\"", false, str);
+		return (false);
+	}
+	m_wearCurveSet = true;
+	m_logger.log(Loglevel::INFO, "Set wear curve: %s", false, str);
+	return (true);
+}
+
+// comma separated <key>=<value>, erase takes <coefficient>[:<exponent>] (default exponent: 1)
+bool PageManager::parseBitErrorRate(const char *str) {
+	st_rber_model_t rber = {0.0, 0.0, 1.0, 0.0};
+	const char *pos = str;
+	char *end;
+
+	while ('\0' != *pos) {
+		const char *assign = strchr(pos, PARSE_RBER_ASSIGN);
+		if (NULL == assign)
+			goto err;
+		std::string key(pos, assign - pos);
+		double value = strtod(assign + 1, &end);
+		if ((end == assign + 1) || (value < 0.0))
+			goto err;
+
+		if (PARSE_RBER_BASE == key) {
+			rber.base = value;
+		} else if (PARSE_RBER_ERASE == key) {
+			rber.erase = value;
+			if (PARSE_SPAN_DELIM == *end) {
+				const char *exp = end + 1;
+				rber.eraseExp = strtod(exp, &end);
+				if ((end == exp) || (rber.eraseExp < 0.0))
+					goto err;
+			}
+		} else if (PARSE_RBER_READ == key) {
+			rber.read = value;
+		} else {
+			goto err;
+		}
+		if (('\0' != *end) && (PARSE_PROP_DELIM != *end))
+			goto err;
+		pos = ('\0' == *end)?(end):(end + 1);
+	}
+	m_rber = rber;
+	m_rberSet = true;
+	m_logger.log(Loglevel::INFO, "Set raw bit error rate: %s", false, str);
+	return (true);
+
+err:
+	m_logger.log(Loglevel::ERROR, "Invalid raw bit error rate: \"%s\"", false, str);
+	return (false);
+}
+
+double PageManager::getBitErrorRate(const unsigned index) {
+	const st_page_t &page = m_pages[index];
+	double rate = m_rber.base + m_rber.read * page.reads;
+	if (0.0 != m_rber.erase)
+		rate += m_rber.erase * pow(static_cast<double>(page.erases), m_rber.eraseExp);
+	return (fmin(rate, RBER_MAX));
+}
+
+// Geometric skip sampling: distance to next flipped bit is drawn directly,
+// floor(ln(u) / ln(1 - p)), so cost depends on number of errors only.
+unsigned long PageManager::flipBits(const unsigned index, char *buffer, const size_t count) {
+	double rate = getBitErrorRate(index);
+	if (rate <= 0.0)
+		return (0);
+
+	const double scale = 1.0 / log1p(-rate);
+	const double bits = count * 8.0;
+	unsigned long flipped = 0;
+	for (double pos = floor(log((random() + 1.0) / (RAND_MAX + 1.0)) * scale); pos < bits;
+			pos += 1.0 + floor(log((random() + 1.0) / (RAND_MAX + 1.0)) * scale)) {
+		unsigned long bit = static_cast<unsigned long>(pos);
+		buffer[bit / 8] ^= (1 << (bit % 8));
+		flipped++;
 	}
+	return (flipped);
+}
+
+// Page without fault becomes weak one with limit drawn from wear curve,
+// given it has survived cycles done so far, so it fails later as well
+// when it's used normally after aging.
+bool PageManager::agePage(const unsigned index, const unsigned long erases, const unsigned long programs) {
+	st_page_t &page = m_pages[index];
+	bool worn = isPageWorn(index);
+
+	if ((E_PAGE_NORMAL == page.type) && m_wearCurveSet && (0 != erases)) {
+		setPageFault(index, E_PAGE_WEAK, drawLimit(m_wearCurve, page.erases));
+		m_weakPages++;
+	}
+	page.erases += erases;
+	page.writes += programs;
+	return (!worn && isPageWorn(index));
+}
+
+void PageManager::setBitMask(const unsigned index, char *buffer) {
+	const st_dead_bit_t *dead_bits = m_pages[index].deadBits;
+	for (int i = 0; i < PAGE_BITFLIP_LIMIT; ++i)
+		buffer[dead_bits[i].byte] &= ~(1 << dead_bits[i].bit);
 }
 
 void PageManager::mergeBitMasks(const unsigned long offset, const unsigned long count, char *dst, const char *src) {
@@ -47,23 +176,119 @@ void PageManager::mergeBitMasks(const unsigned long offset, const unsigned long
 	}
 }
 
-void PageManager::setPageType(const unsigned index, const e_page_type_t type, const unsigned short limit) {
-	getPage(index).type = type;
-	getPage(index).limit = limit;
+// bit counts of bytes of word
+static inline uint64_t swar_byte_popcount(uint64_t v) {
+	v = v - ((v >> 1) & 0x5555555555555555ULL);
+	v = (v & 0x3333333333333333ULL) + ((v >> 2) & 0x3333333333333333ULL);
+	return ((v + (v >> 4)) & 0x0F0F0F0F0F0F0F0FULL);
+}
+
+// sum of bytes of word
+static inline unsigned long swar_byte_sum(uint64_t v) {
+	v = (v & 0x00FF00FF00FF00FFULL) + ((v >> 8) & 0x00FF00FF00FF00FFULL);
+	return ((v * 0x0001000100010001ULL) >> 48);
+}
+
+// Words of 8 bytes are processed at once (SWAR). Bytes equal to programmed
+// ones are zero bytes of xor, which have no high bit set after low 7 bits
+// are added to 0x7F (no carry to next byte is possible). Counts are kept in
+// bytes of words, summed before they can overflow (8 bits * 31 words).
+void PageManager::mergeBitMasks(const unsigned long offset, const unsigned long count, char *dst, const char *src, st_program_check_t &check) {
+	const uint64_t low7 = 0x7F7F7F7F7F7F7F7FULL;
+	const uint64_t high = 0x8080808080808080ULL;
+	char *dst_head = &dst[offset];
+	unsigned long i = 0;
+	uint64_t d, s, x;
+
+	while (i + sizeof(uint64_t) <= count) {
+		uint64_t programmed = 0, identical = 0, illegal = 0;
+		unsigned long words = (count - i) / sizeof(uint64_t);
+		if (words > 31)
+			words = 31;
+		// simple loop, so compiler can vectorize it further
+		for (unsigned long end = i + words * sizeof(uint64_t); i < end; i += sizeof(uint64_t)) {
+			memcpy(&d, &dst_head[i], sizeof(uint64_t));
+			memcpy(&s, &src[i], sizeof(uint64_t));
+			x = d ^ s;
+			identical += (~(((x & low7) + low7) | x) & high) >> 7;
+			programmed += swar_byte_popcount(d & ~s);
+			illegal += swar_byte_popcount(~d & s);
+			d &= s;
+			memcpy(&dst_head[i], &d, sizeof(uint64_t));
+		}
+		check.programmedBits += swar_byte_sum(programmed);
+		check.identicalBytes += swar_byte_sum(identical);
+		check.illegalBits += swar_byte_sum(illegal);
+	}
+	for (; i < count; ++i) {
+		unsigned char db = dst_head[i];
+		unsigned char sb = src[i];
+		check.identicalBytes += (db == sb);
+		check.programmedBits += swar_byte_popcount(db & ~sb & 0xFF);
+		check.illegalBits += swar_byte_popcount(~db & sb & 0xFF);
+		dst_head[i] = db & sb;
+	}
+}
+
+// pages with fault are counted, so device can tell when it has none
+void PageManager::setPageType(const unsigned index, const e_page_type_t type, const unsigned limit) {
+	st_page_t &page = getPage(index);
+	if ((E_PAGE_NORMAL == page.type) && (E_PAGE_NORMAL != type))
+		m_faultyPages++;
+	else if ((E_PAGE_NORMAL != page.type) && (E_PAGE_NORMAL == type) && (0 != m_faultyPages))
+		m_faultyPages--;
+	page.type = type;
+	page.limit = limit;
+	page.behavior = E_BEH_DEFAULT;
+}
+
+void PageManager::restorePage(const unsigned index, const st_page_t &page) {
+	setPageType(index, page.type, page.limit);
+	memcpy(&getPage(index), &page, sizeof(st_page_t));
 }
 
 void PageManager::setPageDeadBits(const unsigned index) {
-	long rnd, bit;
+	long rnd;
 	for (int i = 0; i < PAGE_BITFLIP_LIMIT; ++i) {
-		rnd = rand() % m_libnorsim.getEraseSize();
-		bit = rnd % 8;
-		m_pages[index].deadBits.insert(std::make_tuple(rnd, bit));
+		rnd = random() % m_geometry.getBlockSize(index);
+		m_pages[index].deadBits[i].byte = rnd;
+		m_pages[index].deadBits[i].bit = rnd % 8;
 	}
-	m_libnorsim.getLogger().log(Loglevel::DEBUG, "\tPage deadbits:");
-	std::set<std::tuple<unsigned, unsigned>>::iterator it;
-	for (it = m_pages[index].deadBits.begin(); it != m_pages[index].deadBits.end(); ++it) {
-		m_libnorsim.getLogger().log(Loglevel::DEBUG, "\t\tbyte=%ld, bit=%d", false, std::get<0>(*it), std::get<1>(*it));
+}
+
+void PageManager::setPageFault(const unsigned index, const e_page_type_t type, const unsigned limit, const e_beh_t behavior) {
+	setPageType(index, type, limit);
+	setPageDeadBits(index);
+	getPage(index).behavior = behavior;
+}
+
+// page states are saved to be restored when parsing fails
+bool PageManager::replaceFaults(const char *weakPages, const char *gravePages) {
+	std::unique_ptr<st_page_t[]> saved(new st_page_t[m_pageCount]);
+	e_beh_t behavior_weak = m_behaviorWeak;
+	e_beh_t behavior_grave = m_behaviorGrave;
+	unsigned faulty_pages = m_faultyPages;
+	int weak = 0;
+	int grave = 0;
+
+	memcpy(saved.get(), m_pages, m_pageCount * sizeof(st_page_t));
+	for (unsigned i = 0; i < m_pageCount; ++i)
+		setPageType(i, E_PAGE_NORMAL, 0);
+	m_behaviorWeak = m_behaviorGrave = E_BEH_EIO;
+	if (NULL != weakPages)
+		weak = parsePageType(weakPages, "weak", &m_behaviorWeak, E_PAGE_WEAK);
+	if ((weak >= 0) && (NULL != gravePages))
+		grave = parsePageType(gravePages, "grave", &m_behaviorGrave, E_PAGE_GRAVE);
+	if ((weak < 0) || (grave < 0)) {
+		memcpy(m_pages, saved.get(), m_pageCount * sizeof(st_page_t));
+		m_behaviorWeak = behavior_weak;
+		m_behaviorGrave = behavior_grave;
+		m_faultyPages = faulty_pages;
+		return (false);
 	}
+	m_weakPages = weak;
+	m_gravePages = grave;
+	return (true);
 }
 
 int PageManager::parsePageType(const char *env, const char * const name, e_beh_t * const beh, const e_page_type_t type) {
@@ -71,66 +296,249 @@ int PageManager::parsePageType(const char *env, const char * const name, e_beh_t
 
 	if (0 == strncmp(env, PARSE_BEH_EIO, PARSE_BEH_LEN)) {
 		*beh = E_BEH_EIO;
-		m_libnorsim.getLogger().log(Loglevel::INFO, "Set \"%s pages\" behavior: %s", false, name, PARSE_BEH_EIO);
+		m_logger.log(Loglevel::INFO, "Set \"%s pages\" behavior: %s", false, name, PARSE_BEH_EIO);
 		env = strchr(env, PARSE_PREFIX_DELIM) + 1;
 	}
 	else if (0 == strncmp(env, PARSE_BEH_RND, PARSE_BEH_LEN)) {
 		*beh = E_BEH_RND;
-		m_libnorsim.getLogger().log(Loglevel::INFO, "Set \"%s pages\" behavior: %s", false, name, PARSE_BEH_RND);
+		m_logger.log(Loglevel::INFO, "Set \"%s pages\" behavior: %s", false, name, PARSE_BEH_RND);
 		env = strchr(env, PARSE_PREFIX_DELIM) + 1;
 	} else {
 		*beh = E_BEH_EIO;
-		m_libnorsim.getLogger().log(Loglevel::INFO, "No \"%s pages\" behavior defined, assuming \"eio\"", false, name);
+		m_logger.log(Loglevel::INFO, "No \"%s pages\" behavior defined, assuming \"eio\"", false, name);
 	}
 
 	if ((res = parsePageEnv(env, type)) < 0) {
-		m_libnorsim.getLogger().log(Loglevel::WARNING, "Couldn't parse: \"%s\"", false, env);
+		m_logger.log(Loglevel::WARNING, "Couldn't parse: \"%s\"", false, env);
 		return (res);
 	}
-	m_libnorsim.getLogger().log(Loglevel::INFO, "Set \"%s pages\": %d", false, name, res);
+	m_logger.log(Loglevel::INFO, "Set \"%s pages\": %d", false, name, res);
 	return (res);
 }
 
 int PageManager::parsePageEnv(const char * const str, const e_page_type_t type) {
 	const char *cur_node = str;
-	char *cur_prop;
-	char *end_node;
-	char *end_prop;
+	const char *end_node;
 	int count = -1;
-	unsigned limit;
-	unsigned long page;
+	int res;
 
 	if (0 == str[0])
 		return (0);
+	if (PARSE_FILE_PREFIX == str[0])
+		return (parsePageMapFile(&str[1], type));
 
-	char type_sign = (type == E_PAGE_WEAK)?('W'):('G');
 	do {
-		end_node = (char*)(strchr(cur_node, PARSE_NODE_DELIM));
+		end_node = strchr(cur_node, PARSE_NODE_DELIM);
 		if (NULL == end_node) break;
-		end_prop = (char*)strchr(cur_node, PARSE_PROP_DELIM);
-		if (NULL == end_prop) break;
-
-		page = strtoul(cur_node, &end_prop, 10);
-		cur_prop = ++end_prop;
-		limit = strtoul(cur_prop, NULL, 10);
-		m_libnorsim.getLogger().log(Loglevel::DEBUG, "\t(%c)\tpage=%lu\tlimit=%u", false,
-			type_sign, page, limit
-		);
-		if (page > m_pageCount) {
-			m_libnorsim.getLogger().log(Loglevel::ERROR, "\t(%c)\ttrying to set non existing page (page=%lu > pages=%lu)", false,
-				type_sign, page, m_pageCount
-			);
-			return -1;
-		}
-		setPageType(page, type, limit);
-		setPageDeadBits(page);
+
+		if ((res = parsePageNode(std::string(cur_node, end_node - cur_node).c_str(), type)) < 0)
+			return (-1);
 
 		if (-1 == count)
 			count = 0;
-		++count;
+		count += res;
 		cur_node = ++end_node;
 	} while (NULL != cur_node);
 
 	return (count);
 }
 
+int PageManager::parsePageNode(const char *node, const e_page_type_t type) {
+	char type_sign = (type == E_PAGE_WEAK)?('W'):('G');
+	unsigned long first = 0;
+	unsigned long last = 0;
+	unsigned long stride = 1;
+	double pct = 100.0;
+	const char *pct_sign = strchr(node, PARSE_PCT_SIGN);
+	const char *limit_str = strchr(node, PARSE_PROP_DELIM);
+	const char *span_delim = strchr(node, PARSE_SPAN_DELIM);
+	const char *beh_str;
+	char *end;
+	std::string limit;
+	e_beh_t beh = E_BEH_DEFAULT;
+	st_limit_spec_t spec;
+
+	if ((NULL == limit_str) || ((NULL != pct_sign) && (pct_sign > limit_str)))
+		goto err_syntax;
+	if (span_delim > limit_str)
+		span_delim = NULL;
+
+	// span: "*", "<page>" or "<first>-<last>", optionally followed by "/<stride>"
+	if ((NULL != pct_sign) && (NULL == span_delim)) {
+		last = m_pageCount - 1;
+		end = const_cast<char*>(node);
+	} else if (PARSE_SPAN_ALL == node[0]) {
+		last = m_pageCount - 1;
+		end = const_cast<char*>(&node[1]);
+	} else {
+		first = last = strtoul(node, &end, 10);
+		if (end == node)
+			goto err_syntax;
+		if (PARSE_RANGE_DELIM == *end)
+			last = strtoul(end + 1, &end, 10);
+	}
+	if (PARSE_STRIDE_DELIM == *end)
+		stride = strtoul(end + 1, &end, 10);
+	if (NULL != pct_sign) {
+		if (PARSE_SPAN_DELIM == *end)
+			++end;
+		pct = strtod(end, &end);
+		if (end != pct_sign)
+			goto err_syntax;
+		++end;
+	}
+	if (end != limit_str)
+		goto err_syntax;
+
+	if ((first > last) || (last >= m_pageCount)) {
+		m_logger.log(Loglevel::ERROR, "\t(%c)\ttrying to set non existing page (pages=%lu-%lu, count=%u)", false,
+			type_sign, first, last, m_pageCount
+		);
+		return (-1);
+	}
+	if ((0 == stride) || (pct < 0.0) || (pct > 100.0))
+		goto err_syntax;
+	// behavior of pages can follow cycles, overriding one of their type
+	limit = limit_str + 1;
+	if (NULL != (beh_str = strchr(limit_str + 1, PARSE_PROP_DELIM))) {
+		limit.resize(beh_str - limit_str - 1);
+		if (0 == strcmp(beh_str + 1, PARSE_BEH_EIO))
+			beh = E_BEH_EIO;
+		else if (0 == strcmp(beh_str + 1, PARSE_BEH_RND))
+			beh = E_BEH_RND;
+		else
+			goto err_syntax;
+	}
+	if (!parseLimitSpec(limit.c_str(), &spec))
+		goto err_syntax;
+
+	m_logger.log(Loglevel::DEBUG, "\t(%c)\tpages=%lu-%lu/%lu\tpct=%.2f\tlimit=%s", false,
+		type_sign, first, last, stride, pct, limit_str + 1
+	);
+
+	{
+		// selection sampling: picks exactly round(n * pct) pages of the span in a single pass
+		unsigned long n = (last - first) / stride + 1;
+		unsigned long k = static_cast<unsigned long>(llround(n * pct / 100.0));
+		unsigned long selected = 0;
+		for (unsigned long i = 0; (i < n) && (selected < k); ++i) {
+			if ((k != n) && ((n - i) * (random() / (RAND_MAX + 1.0)) >= (k - selected)))
+				continue;
+			setPageFault(first + i * stride, type, drawLimit(spec), beh);
+			++selected;
+		}
+		return (selected);
+	}
+
+err_syntax:
+	m_logger.log(Loglevel::ERROR, "\t(%c)\tinvalid page node: \"%s\"", false, type_sign, node);
+	return (-1);
+}
+
+int PageManager::parsePageMapFile(const char *path, const e_page_type_t type) {
+	char type_sign = (type == E_PAGE_WEAK)?('W'):('G');
+	int count = -1;
+	struct stat st;
+	void *map;
+	const st_fault_map_header_t *header;
+	const st_fault_map_record_t *records;
+
+	// stream is closed by fclose(), interposed close() can't be reached while library is being initialized
+	FILE *file = fopen(path, "rb");
+	if (NULL == file) {
+		m_logger.log(Loglevel::ERROR, "\t(%c)\tcouldn't open fault map: %s", false, type_sign, path);
+		return (-1);
+	}
+	if ((fstat(fileno(file), &st) < 0) || (static_cast<size_t>(st.st_size) < sizeof(st_fault_map_header_t))) {
+		m_logger.log(Loglevel::ERROR, "\t(%c)\tfault map too short: %s", false, type_sign, path);
+		fclose(file);
+		return (-1);
+	}
+	map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fileno(file), 0);
+	fclose(file);
+	if (MAP_FAILED == map) {
+		m_logger.log(Loglevel::ERROR, "\t(%c)\tcouldn't map fault map: %s", false, type_sign, path);
+		return (-1);
+	}
+
+	header = static_cast<const st_fault_map_header_t*>(map);
+	records = reinterpret_cast<const st_fault_map_record_t*>(&header[1]);
+	if ((0 != memcmp(header->magic, FAULT_MAP_MAGIC, sizeof(header->magic))) ||
+		(FAULT_MAP_VERSION != header->version) ||
+		((st.st_size - sizeof(st_fault_map_header_t)) / sizeof(st_fault_map_record_t) < header->count)) {
+		m_logger.log(Loglevel::ERROR, "\t(%c)\tinvalid fault map: %s", false, type_sign, path);
+		goto out;
+	}
+	for (uint32_t i = 0; i < header->count; ++i) {
+		if (records[i].page >= m_pageCount) {
+			m_logger.log(Loglevel::ERROR, "\t(%c)\ttrying to set non existing page (page=%u >= pages=%u)", false,
+				type_sign, records[i].page, m_pageCount
+			);
+			goto out;
+		}
+	}
+	for (uint32_t i = 0; i < header->count; ++i)
+		setPageFault(records[i].page, type, records[i].limit);
+	count = header->count;
+	m_logger.log(Loglevel::DEBUG, "\t(%c)\tloaded %d pages from fault map: %s", false, type_sign, count, path);
+
+out:
+	munmap(map, st.st_size);
+	return (count);
+}
+
+bool PageManager::parseLimitSpec(const char *str, st_limit_spec_t * const spec) {
+	char *end;
+
+	spec->a = spec->b = 0.0;
+	if (0 == strncmp(str, PARSE_DIST_UNIFORM, PARSE_DIST_LEN)) {
+		spec->dist = E_DIST_UNIFORM;
+	} else if (0 == strncmp(str, PARSE_DIST_WEIBULL, PARSE_DIST_LEN)) {
+		spec->dist = E_DIST_WEIBULL;
+	} else {
+		spec->dist = E_DIST_FIXED;
+		spec->a = strtoul(str, &end, 10);
+		return ((end != str) && (0 == *end));
+	}
+
+	str += PARSE_DIST_LEN;
+	if (PARSE_DIST_DELIM != *str)
+		return (false);
+	spec->a = strtod(str + 1, &end);
+	if ((end == str + 1) || (PARSE_DIST_DELIM != *end))
+		return (false);
+	str = end + 1;
+	spec->b = strtod(str, &end);
+	if ((end == str) || (0 != *end))
+		return (false);
+
+	if (E_DIST_UNIFORM == spec->dist)
+		return ((spec->a >= 0.0) && (spec->a <= spec->b));
+	return ((spec->a > 0.0) && (spec->b > 0.0));
+}
+
+// Inverse transform sampling, limit is drawn from distribution truncated to
+// values not below given cycles (u is mapped to [F(cycles), 1)).
+unsigned PageManager::drawLimit(const st_limit_spec_t &spec, const unsigned long cycles) {
+	double u = random() / (RAND_MAX + 1.0);
+	double x = static_cast<double>(cycles);
+	double f;
+	double limit;
+
+	switch (spec.dist) {
+		case E_DIST_UNIFORM:
+			f = fmin(fmax((x - spec.a) / (spec.b - spec.a + 1.0), 0.0), 1.0);
+			limit = spec.a + (f + u * (1.0 - f)) * (spec.b - spec.a + 1.0);
+			break;
+		case E_DIST_WEIBULL:
+			// -ln(1 - F(x)) = (x / scale)^shape
+			limit = spec.b * pow(pow(x / spec.b, spec.a) - log1p(-u), 1.0 / spec.a);
+			break;
+		default: limit = spec.a; break;
+	}
+	if (limit < x)
+		limit = x;
+	if (limit >= static_cast<double>(UINT32_MAX))
+		return (UINT32_MAX);
+	return (static_cast<unsigned>(limit));
+}
@@ -3,13 +3,48 @@
 
 #define PAGE_BITFLIP_LIMIT 4
 
+#define FAULT_MAP_MAGIC   "NSFM"
+#define FAULT_MAP_VERSION 1
+
+// same as state of rand(), so sequences for given seed don't change
+#define PAGE_RANDOM_STATE_SIZE 128
+
+#define PARSE_BEH_EIO "eio"
+#define PARSE_BEH_RND "rnd"
+#define PARSE_BEH_LEN 3
+
+#define PARSE_NODE_DELIM   ';'
+#define PARSE_PROP_DELIM   ','
+#define PARSE_PREFIX_DELIM ' '
+#define PARSE_RANGE_DELIM  '-'
+#define PARSE_STRIDE_DELIM '/'
+#define PARSE_SPAN_DELIM   ':'
+#define PARSE_SPAN_ALL     '*'
+#define PARSE_PCT_SIGN     '%'
+#define PARSE_FILE_PREFIX  '@'
+
+#define PARSE_DIST_UNIFORM "uni"
+#define PARSE_DIST_WEIBULL "wbl"
+#define PARSE_DIST_LEN     3
+#define PARSE_DIST_DELIM   ':'
+
+#define PARSE_RBER_BASE   "base"
+#define PARSE_RBER_ERASE  "erase"
+#define PARSE_RBER_READ   "read"
+#define PARSE_RBER_ASSIGN '='
+// errors are sampled from binomial distribution, so rate is limited to it
+#define RBER_MAX 0.5
+
+#include <cstdint>
+#include <cstdlib>
 #include <memory>
-#include <set>
-#include <tuple>
+
+#include "NorGeometry.h"
 
 enum e_beh_t {
 	E_BEH_EIO = 0,
-	E_BEH_RND
+	E_BEH_RND,
+	E_BEH_DEFAULT // of page: behavior of its type
 } ;
 
 enum e_page_type_t {
@@ -18,14 +53,20 @@ enum e_page_type_t {
 	E_PAGE_GRAVE  = 0b0010
 };
 
+struct st_dead_bit_t {
+	unsigned byte;
+	unsigned bit;
+};
+
 struct st_page_t {
 	e_page_type_t type;
-	unsigned short limit;
+	unsigned limit;
 	unsigned long reads;
 	unsigned long writes;
 	unsigned long erases;
-	std::set<std::tuple<unsigned, unsigned>> deadBits;
+	st_dead_bit_t deadBits[PAGE_BITFLIP_LIMIT];
 	bool unlocked;
+	e_beh_t behavior;
 };
 
 struct st_page_stats_t {
@@ -37,44 +78,136 @@ struct st_page_stats_t {
 	unsigned long max_erases;
 };
 
-class Libnorsim;
+// binary fault map file: header followed by header.count records
+struct st_fault_map_header_t {
+	char magic[4];
+	uint32_t version;
+	uint32_t count;
+	uint32_t reserved;
+};
+
+struct st_fault_map_record_t {
+	uint32_t page;
+	uint32_t limit;
+};
+
+// counted by checked merge of programmed data with contents
+struct st_program_check_t {
+	unsigned long programmedBits; // bits cleared (1->0)
+	unsigned long identicalBytes; // bytes having programmed value already
+	unsigned long illegalBits;    // bits to be set (0->1), which program can't do
+};
+
+enum e_limit_dist_t {
+	E_DIST_FIXED = 0,
+	E_DIST_UNIFORM,
+	E_DIST_WEIBULL
+};
 
+struct st_limit_spec_t {
+	e_limit_dist_t dist;
+	double a;
+	double b;
+};
+
+// raw bit error rate of page: base + erase * erases^eraseExp + read * reads
+struct st_rber_model_t {
+	double base;
+	double erase;
+	double eraseExp;
+	double read;
+};
+
+class Logger;
+
+// Page states and faults of one device, random values (limits, dead bits and
+// randomized data) are drawn from its own generator
 class PageManager {
 public:
-	PageManager(Libnorsim &libnorsim, const unsigned pageCount);
+	// pages are allocated when shared ones (already initialized) aren't given
+	PageManager(Logger &logger, NorGeometry &geometry, const unsigned seed, st_page_t *sharedPages);
 
 	unsigned getPageCount() { return (m_pageCount); }
 	int getWeakPageCount() { return (m_weakPages); }
 	int getGravePageCount() { return (m_gravePages); }
+	// any page has fault now, shared pages can get them from other processes any time
+	bool hasFaults() { return ((0 != m_faultyPages) || !m_ownedPages); }
 
 	e_beh_t getWeakPageBehavior() { return (m_behaviorWeak); }
 	e_beh_t getGravePageBehavior() { return (m_behaviorGrave); }
+	e_beh_t getPageBehavior(const unsigned index) {
+		if (E_BEH_DEFAULT != m_pages[index].behavior)
+			return (m_pages[index].behavior);
+		return ((E_PAGE_GRAVE == m_pages[index].type)?(m_behaviorGrave):(m_behaviorWeak));
+	}
 
-	st_page_t& getPage(const unsigned index) { return (m_pages.get()[index]); }
+	st_page_t& getPage(const unsigned index) { return (m_pages[index]); }
 
 	void parseWeakPagesEnv(const char *env);
 	void parseGravePagesEnv(const char *env);
+	// faults of shared pages were set up by other process
+	void setFaultSummary(const int weakPages, const int gravePages, const e_beh_t behaviorWeak, const e_beh_t behaviorGrave);
+	void setBehavior(const e_page_type_t type, const e_beh_t behavior);
+	void setPageFault(const unsigned index, const e_page_type_t type, const unsigned limit, const e_beh_t behavior = E_BEH_DEFAULT);
+	void clearPageFault(const unsigned index);
+	// whole state of page (e.g. saved one) replaces current one
+	void restorePage(const unsigned index, const st_page_t &page);
+	// Faults of all pages (aged ones too) are replaced by given ones (NULL - none)
+	// at once, counters are kept. Nothing is changed when spec is invalid.
+	bool replaceFaults(const char *weakPages, const char *gravePages);
+	// endurance of pages without fault, used when they are aged (limit format of weak pages)
+	bool parseWearCurve(const char *str);
+	// returns true when page wears out by given cycles
+	bool agePage(const unsigned index, const unsigned long erases, const unsigned long programs);
+	bool isPageWorn(const unsigned index) { return ((E_PAGE_WEAK == m_pages[index].type) && (m_pages[index].erases > m_pages[index].limit)); }
+
+	// bit errors of data read from pages (NS_RBER format)
+	bool parseBitErrorRate(const char *str);
+	bool hasBitErrorRate() { return (m_rberSet); }
+	double getBitErrorRate(const unsigned index);
+	// returns number of flipped bits
+	unsigned long flipBits(const unsigned index, char *buffer, const size_t count);
+
+	int random() { int32_t value; random_r(&m_random, &value); return (value); }
 
 	void setBitMask(const unsigned index, char *buffer);
 	void mergeBitMasks(const unsigned long offset, const unsigned long count, char *dst, const char *src);
+	// same merge, counting what it changes (adds to check)
+	void mergeBitMasks(const unsigned long offset, const unsigned long count, char *dst, const char *src, st_program_check_t &check);
 
 private:
-	void setPageType(const unsigned index, const e_page_type_t type, const unsigned short limit);
+	void setPageType(const unsigned index, const e_page_type_t type, const unsigned limit);
 	void setPageDeadBits(const unsigned index);
 
 	int parsePageType(const char *env, const char * const name, e_beh_t * const beh, const e_page_type_t type);
 	int parsePageEnv(const char * const str, const e_page_type_t type);
-	
+	int parsePageNode(const char *node, const e_page_type_t type);
+	int parsePageMapFile(const char *path, const e_page_type_t type);
+
+	bool parseLimitSpec(const char *str, st_limit_spec_t * const spec);
+	unsigned drawLimit(const st_limit_spec_t &spec, const unsigned long cycles = 0);
+
 	int m_weakPages;
 	int m_gravePages;
 	unsigned m_pageCount;
+	NorGeometry &m_geometry;
 
 	e_beh_t m_behaviorWeak;
 	e_beh_t m_behaviorGrave;
 
-	std::unique_ptr<st_page_t[]> m_pages;
+	unsigned m_faultyPages;
+	bool m_wearCurveSet;
+	st_limit_spec_t m_wearCurve;
+	bool m_rberSet;
+	st_rber_model_t m_rber;
+
+	st_page_t *m_pages;
+	std::unique_ptr<st_page_t[]> m_ownedPages;
+
+	struct random_data m_random;
+	char m_randomState[PAGE_RANDOM_STATE_SIZE];
 
-	Libnorsim &m_libnorsim;
+	Logger &m_logger;
 };
 
-#endif // __PAGEMANAGER_H__
\ No newline at end of file
+#endif // __PAGEMANAGER_H__
@@ -0,0 +1,32 @@
+#ifndef __PROBES_H__
+#define __PROBES_H__
+
+// USDT probes of provider "libnorsim", compiled in when Makefile finds
+// sys/sdt.h (single NOP per probe until attached), no-op otherwise.
+//
+// pread(index, offset, count, reads)
+// pwrite(index, offset, count, writes)
+// unlock(first, count)
+// erase(first, count)
+// erase_block(index, erases, worn)
+// fault(op, index, behavior, counter, limit) - op is e_trace_op_t, behavior is e_beh_t
+// io_read(fd, offset, count, result)
+// io_write(fd, offset, count, result)
+// io_request(op, fd, offset, count, result) - op is e_io_op_t, queued request completed by submit()
+// io_submit(count, ok)
+
+#ifdef NORSIM_USDT
+#include <sys/sdt.h>
+
+#define PROBE2(name, a1, a2) DTRACE_PROBE2(libnorsim, name, a1, a2)
+#define PROBE3(name, a1, a2, a3) DTRACE_PROBE3(libnorsim, name, a1, a2, a3)
+#define PROBE4(name, a1, a2, a3, a4) DTRACE_PROBE4(libnorsim, name, a1, a2, a3, a4)
+#define PROBE5(name, a1, a2, a3, a4, a5) DTRACE_PROBE5(libnorsim, name, a1, a2, a3, a4, a5)
+#else
+#define PROBE2(name, a1, a2) do { (void)(a1); (void)(a2); } while (0)
+#define PROBE3(name, a1, a2, a3) do { (void)(a1); (void)(a2); (void)(a3); } while (0)
+#define PROBE4(name, a1, a2, a3, a4) do { (void)(a1); (void)(a2); (void)(a3); (void)(a4); } while (0)
+#define PROBE5(name, a1, a2, a3, a4, a5) do { (void)(a1); (void)(a2); (void)(a3); (void)(a4); (void)(a5); } while (0)
+#endif
+
+#endif // __PROBES_H__
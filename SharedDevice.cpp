@@ -0,0 +1,178 @@
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include "SharedDevice.h"
+#include "Libnorsim.h"
+#include "Logger.h"
+
+#define SHARED_ALIGN(x, a) (((x) + (a) - 1) & ~((a) - 1))
+
+SharedDevice::SharedDevice(Libnorsim &libnorsim, const dev_t dev, const ino_t ino, const unsigned pageCount)
+ : m_fd(-1), m_creator(false), m_initLocked(false), m_pageCount(pageCount), m_pid(getpid()),
+   m_header(NULL), m_locks(NULL), m_pages(NULL), m_libnorsim(libnorsim) {
+	memset(&m_stats, 0x00, sizeof(m_stats));
+	snprintf(m_name, sizeof(m_name), SHARED_NAME_FORMAT, static_cast<unsigned long>(dev), static_cast<unsigned long>(ino));
+	m_locksOffset = SHARED_ALIGN(sizeof(st_shared_header_t), alignof(pthread_mutex_t));
+	m_pagesOffset = SHARED_ALIGN(m_locksOffset + sizeof(pthread_mutex_t) * m_pageCount, alignof(st_page_t));
+	m_mapSize = m_pagesOffset + sizeof(st_page_t) * m_pageCount;
+
+	m_fd = shm_open(m_name, O_RDWR | O_CREAT | O_CLOEXEC, 0600);
+	if (m_fd < 0) {
+		m_libnorsim.getLogger().log(Loglevel::ERROR, "Couldn't open shared memory object: %s, errno=%d", false, m_name, errno);
+		return;
+	}
+	if (!lockByte(SHARED_LOCK_INIT, F_WRLCK, true))
+		return;
+	m_initLocked = true;
+
+	// nobody uses device when "alive" byte can be locked exclusively, state left there (if any) is stale
+	m_creator = lockByte(SHARED_LOCK_ALIVE, F_WRLCK, false);
+	if ((m_creator)?(!create()):(!join()))
+		return;
+	if (!lockByte(SHARED_LOCK_ALIVE, F_RDLCK, true)) {
+		munmap(m_header, m_mapSize);
+		m_header = NULL;
+		return;
+	}
+	m_header->attached++;
+
+	m_libnorsim.getLogger().log(Loglevel::INFO, "Set shared device: %s (%s, %u processes attached)", false,
+		m_name, (m_creator)?("created"):("joined"), m_header->attached);
+	if (!m_creator) {
+		lockByte(SHARED_LOCK_INIT, F_UNLCK, true);
+		m_initLocked = false;
+	}
+}
+
+// forked child shares locks with its parent, it only drops mapping
+SharedDevice::~SharedDevice() {
+	if ((NULL != m_header) && (getpid() == m_pid)) {
+		bool last;
+		lockByte(SHARED_LOCK_INIT, F_WRLCK, true);
+		m_header->attached--;
+		last = lockByte(SHARED_LOCK_ALIVE, F_WRLCK, false);
+		munmap(m_header, m_mapSize);
+		if (last)
+			shm_unlink(m_name);
+	} else if (NULL != m_header) {
+		munmap(m_header, m_mapSize);
+	}
+	if ((m_fd >= 0) && (getpid() == m_pid))
+		m_libnorsim.getSyscallsCache().invokeClose(m_fd);
+}
+
+void SharedDevice::publish(PageManager &pm) {
+	if (!m_initLocked)
+		return;
+	m_header->weakPages = pm.getWeakPageCount();
+	m_header->gravePages = pm.getGravePageCount();
+	m_header->behaviorWeak = pm.getWeakPageBehavior();
+	m_header->behaviorGrave = pm.getGravePageBehavior();
+	memcpy(m_header->magic, SHARED_MAGIC, sizeof(m_header->magic));
+	lockByte(SHARED_LOCK_INIT, F_UNLCK, true);
+	m_initLocked = false;
+}
+
+void SharedDevice::lock(const unsigned first, const unsigned count) {
+	for (unsigned index = first; index < first + count; ++index) {
+		int ret = pthread_mutex_trylock(&m_locks[index]);
+		if (EBUSY == ret) {
+			m_stats.contended++;
+			ret = pthread_mutex_lock(&m_locks[index]);
+		}
+		if (EOWNERDEAD == ret) {
+			m_stats.recovered++;
+			m_libnorsim.getLogger().log(Loglevel::WARNING, "Shared device: page %u was held by terminated process", false, index);
+			pthread_mutex_consistent(&m_locks[index]);
+		}
+	}
+}
+
+void SharedDevice::unlock(const unsigned first, const unsigned count) {
+	for (unsigned index = first + count; index > first; --index)
+		pthread_mutex_unlock(&m_locks[index - 1]);
+}
+
+// open file description locks are released when descriptor is closed, also by terminated process
+bool SharedDevice::lockByte(const off_t byte, const short type, const bool wait) {
+	struct flock fl;
+	memset(&fl, 0x00, sizeof(fl));
+	fl.l_type = type;
+	fl.l_whence = SEEK_SET;
+	fl.l_start = byte;
+	fl.l_len = 1;
+	if (0 == fcntl(m_fd, (wait)?(F_OFD_SETLKW):(F_OFD_SETLK), &fl))
+		return (true);
+	if (wait)
+		m_libnorsim.getLogger().log(Loglevel::ERROR, "Couldn't lock shared memory object: %s, errno=%d", false, m_name, errno);
+	return (false);
+}
+
+// new object is zero filled, which is initial state of pages but their behavior
+bool SharedDevice::create() {
+	if ((ftruncate(m_fd, 0) < 0) || (ftruncate(m_fd, m_mapSize) < 0)) {
+		m_libnorsim.getLogger().log(Loglevel::ERROR, "Couldn't resize shared memory object: %s", false, m_name);
+		return (false);
+	}
+	if (!map())
+		return (false);
+
+	m_header->version = SHARED_VERSION;
+	m_header->size = m_libnorsim.getSize();
+	m_header->eraseSize = m_libnorsim.getEraseSize();
+	m_header->pageCount = m_pageCount;
+	m_header->lockSize = sizeof(pthread_mutex_t);
+	m_header->pageSize = sizeof(st_page_t);
+
+	pthread_mutexattr_t attr;
+	pthread_mutexattr_init(&attr);
+	pthread_mutexattr_setpshared(&attr, PTHREAD_PROCESS_SHARED);
+	pthread_mutexattr_setrobust(&attr, PTHREAD_MUTEX_ROBUST);
+	for (unsigned index = 0; index < m_pageCount; ++index) {
+		pthread_mutex_init(&m_locks[index], &attr);
+		m_pages[index].behavior = E_BEH_DEFAULT;
+	}
+	pthread_mutexattr_destroy(&attr);
+	return (true);
+}
+
+bool SharedDevice::join() {
+	struct stat st;
+	if ((fstat(m_fd, &st) < 0) || (static_cast<size_t>(st.st_size) != m_mapSize)) {
+		m_libnorsim.getLogger().log(Loglevel::ERROR, "Shared device %s doesn't match flash geometry", false, m_name);
+		return (false);
+	}
+	if (!map())
+		return (false);
+	if ((0 != memcmp(m_header->magic, SHARED_MAGIC, sizeof(m_header->magic))) ||
+		(SHARED_VERSION != m_header->version) ||
+		(m_libnorsim.getSize() != m_header->size) ||
+		(m_libnorsim.getEraseSize() != m_header->eraseSize) ||
+		(m_pageCount != m_header->pageCount) ||
+		(sizeof(pthread_mutex_t) != m_header->lockSize) ||
+		(sizeof(st_page_t) != m_header->pageSize)) {
+		m_libnorsim.getLogger().log(Loglevel::ERROR, "Shared device %s doesn't match flash geometry", false, m_name);
+		munmap(m_header, m_mapSize);
+		m_header = NULL;
+		return (false);
+	}
+	return (true);
+}
+
+bool SharedDevice::map() {
+	void *map = mmap(NULL, m_mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+	if (MAP_FAILED == map) {
+		m_libnorsim.getLogger().log(Loglevel::ERROR, "Couldn't map shared memory object: %s", false, m_name);
+		return (false);
+	}
+	m_header = static_cast<st_shared_header_t*>(map);
+	m_locks = reinterpret_cast<pthread_mutex_t*>(&static_cast<char*>(map)[m_locksOffset]);
+	m_pages = reinterpret_cast<st_page_t*>(&static_cast<char*>(map)[m_pagesOffset]);
+	return (true);
+}
@@ -0,0 +1,91 @@
+#ifndef __SHAREDDEVICE_H__
+#define __SHAREDDEVICE_H__
+
+#define SHARED_MAGIC       "NSSD"
+#define SHARED_VERSION     2
+#define SHARED_NAME_FORMAT "/libnorsim-%lx-%lx"
+#define SHARED_NAME_LENGTH 64
+
+// bytes of shared memory object locked with open file description locks
+#define SHARED_LOCK_INIT  0
+#define SHARED_LOCK_ALIVE 1
+
+#include <cstdint>
+
+#include <pthread.h>
+#include <sys/types.h>
+
+#include "PageManager.h"
+
+// beginning of shared memory object, followed by block locks and page states
+struct st_shared_header_t {
+	char magic[4];
+	uint32_t version;
+	uint64_t size;
+	uint64_t eraseSize;
+	uint32_t pageCount;
+	uint32_t lockSize;
+	uint32_t pageSize;
+	int32_t weakPages;
+	int32_t gravePages;
+	uint32_t behaviorWeak;
+	uint32_t behaviorGrave;
+	uint32_t attached;
+};
+
+struct st_shared_stats_t {
+	unsigned long contended;
+	unsigned long recovered;
+};
+
+class Libnorsim;
+
+// Page states (counters, fault map, lock state) of device kept in shared memory
+// object named after cache file, so processes using same cache file share them.
+// Each block has process-shared robust mutex held while it's accessed. State is
+// created by first process attaching, processes joining later take faults from
+// it. Last process detaching removes object, state left by crashed processes is
+// recreated. Block cache and asynchronous erase state stay private to process.
+class SharedDevice {
+public:
+	SharedDevice(Libnorsim &libnorsim, const dev_t dev, const ino_t ino, const unsigned pageCount);
+	~SharedDevice();
+
+	bool isOk() { return (NULL != m_header); }
+	bool isCreator() { return (m_creator); }
+	const char* getName() { return (m_name); }
+	st_shared_header_t& getHeader() { return (*m_header); }
+	st_page_t* getPages() { return (m_pages); }
+	const st_shared_stats_t& getStats() { return (m_stats); }
+
+	// fault summary is stored by creator, then other processes can attach
+	void publish(PageManager &pm);
+
+	// blocks are always locked in ascending order
+	void lock(const unsigned first, const unsigned count);
+	void unlock(const unsigned first, const unsigned count);
+
+private:
+	bool lockByte(const off_t byte, const short type, const bool wait);
+	bool create();
+	bool join();
+	bool map();
+
+	int m_fd;
+	char m_name[SHARED_NAME_LENGTH];
+	bool m_creator;
+	bool m_initLocked;
+	unsigned m_pageCount;
+	pid_t m_pid;
+	size_t m_locksOffset;
+	size_t m_pagesOffset;
+	size_t m_mapSize;
+	st_shared_header_t *m_header;
+	pthread_mutex_t *m_locks;
+	st_page_t *m_pages;
+	st_shared_stats_t m_stats;
+
+	Libnorsim &m_libnorsim;
+};
+
+#endif // __SHAREDDEVICE_H__
@@ -0,0 +1,194 @@
+#include <chrono>
+#include <cstring>
+
+#include <fcntl.h>
+
+#include "Libnorsim.h"
+#include "Logger.h"
+#include "SyncPolicy.h"
+
+SyncPolicy::SyncPolicy(Libnorsim &libnorsim, const e_sync_mode_t mode, const unsigned long interval)
+ : m_mode(mode), m_interval(interval), m_pendingOps(0), m_written(0), m_synced(0),
+   m_dirtyStart(0), m_dirtyEnd(0), m_flushRequested(false), m_stop(false), m_libnorsim(libnorsim) {
+	memset(&m_stats, 0x00, sizeof(m_stats));
+	if ((E_SYNC_OPS == m_mode) || (E_SYNC_MS == m_mode))
+		m_flusher = std::thread(&SyncPolicy::flusherMain, this);
+}
+
+// cache file left open by application is synced last time
+SyncPolicy::~SyncPolicy() {
+	if (m_flusher.joinable()) {
+		{
+			std::lock_guard<std::mutex> lg(m_flusherMutex);
+			m_stop = true;
+		}
+		m_flusherCond.notify_one();
+		m_flusher.join();
+	}
+	std::lock_guard<std::mutex> lg(m_libnorsim.getGlobalMutex());
+	if ((E_SYNC_NONE != m_mode) && m_libnorsim.isOpened() && isDirty())
+		syncLocked();
+}
+
+const char* SyncPolicy::getName() {
+	switch (m_mode) {
+		case E_SYNC_NONE: return ("none");
+		case E_SYNC_CLOSE: return ("on close");
+		case E_SYNC_OPS: return ("per operations");
+		case E_SYNC_MS: return ("per milliseconds");
+		case E_SYNC_ERASE: return ("per erase");
+	}
+	return ("unknown");
+}
+
+void SyncPolicy::noteWrite(off_t offset, size_t count) {
+	if (E_SYNC_NONE == m_mode)
+		return;
+	if (m_dirtyStart == m_dirtyEnd) {
+		m_dirtyStart = offset;
+		m_dirtyEnd = offset + count;
+	} else {
+		if (offset < m_dirtyStart)
+			m_dirtyStart = offset;
+		if (static_cast<off_t>(offset + count) > m_dirtyEnd)
+			m_dirtyEnd = offset + count;
+	}
+	m_written++;
+	if ((E_SYNC_OPS == m_mode) && (++m_pendingOps >= m_interval)) {
+		m_pendingOps = 0;
+		wakeFlusher();
+	}
+}
+
+void SyncPolicy::noteErase(off_t offset, size_t count) {
+	noteWrite(offset, count);
+	if (E_SYNC_ERASE == m_mode)
+		syncLocked();
+}
+
+// every mode but "none" leaves cache file durable when it is closed
+void SyncPolicy::noteClose() {
+	if ((E_SYNC_NONE != m_mode) && isDirty())
+		syncLocked();
+}
+
+int SyncPolicy::requestSync() {
+	m_stats.requests++;
+	if ((E_SYNC_NONE == m_mode) || !isDirty()) {
+		m_stats.skipped++;
+		return (0);
+	}
+	return (syncLocked());
+}
+
+// block cache is written back, so whole dirty range is in cache file
+bool SyncPolicy::collect(off_t &start, off_t &end) {
+	BlockCache *cache = m_libnorsim.getBlockCache();
+	if ((NULL != cache) && !cache->flush())
+		return (false);
+	start = m_dirtyStart;
+	end = m_dirtyEnd;
+	m_dirtyStart = m_dirtyEnd = 0;
+	return (true);
+}
+
+void SyncPolicy::restore(off_t start, off_t end) {
+	if (start == end)
+		return;
+	if ((m_dirtyStart == m_dirtyEnd) || (start < m_dirtyStart))
+		m_dirtyStart = start;
+	if (end > m_dirtyEnd)
+		m_dirtyEnd = end;
+}
+
+int SyncPolicy::syncLocked() {
+	off_t start, end;
+	uint64_t written = m_written;
+
+	if (!collect(start, end)) {
+		m_libnorsim.getLogger().log(Loglevel::ERROR, "Sync: couldn't flush block cache");
+		return (-1);
+	}
+	if (0 != syncFile(m_libnorsim.getBackingFd(), start, end)) {
+		restore(start, end);
+		return (-1);
+	}
+	m_synced = written;
+	m_stats.syncs++;
+	return (0);
+}
+
+// range is written out first, fdatasync() is left with device cache flush
+int SyncPolicy::syncFile(int fd, off_t start, off_t end) {
+	if ((start != end) && (0 != sync_file_range(fd, start, end - start,
+		SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE | SYNC_FILE_RANGE_WAIT_AFTER))) {
+		m_libnorsim.getLogger().log(Loglevel::ERROR, "Sync: sync_file_range failed, errno=%d", false, errno);
+		return (-1);
+	}
+	// called directly, flusher thread must not touch shared errno state of SyscallsCache
+	if (0 != m_libnorsim.getSyscallsCache().getSyscalls().fdatasyncSC(fd)) {
+		m_libnorsim.getLogger().log(Loglevel::ERROR, "Sync: fdatasync failed, errno=%d", false, errno);
+		return (-1);
+	}
+	return (0);
+}
+
+void SyncPolicy::flusherMain() {
+	std::unique_lock<std::mutex> lock(m_flusherMutex);
+	while (!m_stop) {
+		if (E_SYNC_MS == m_mode)
+			m_flusherCond.wait_for(lock, std::chrono::milliseconds(m_interval), [this]() { return (m_stop || m_flushRequested); });
+		else
+			m_flusherCond.wait(lock, [this]() { return (m_stop || m_flushRequested); });
+		if (m_stop)
+			break;
+		m_flushRequested = false;
+		lock.unlock();
+		flushInBackground();
+		lock.lock();
+	}
+}
+
+// Dirty data is collected with global mutex held, slow part runs without it
+// on duplicated descriptor, so emulation continues and cache file can be
+// closed meanwhile. Writes done during sync are picked up by next one.
+void SyncPolicy::flushInBackground() {
+	off_t start, end;
+	uint64_t written;
+	int fd;
+	{
+		std::lock_guard<std::mutex> lg(m_libnorsim.getGlobalMutex());
+		if (!m_libnorsim.isOpened() || !isDirty())
+			return;
+		if (!collect(start, end)) {
+			m_libnorsim.getLogger().log(Loglevel::ERROR, "Sync: couldn't flush block cache");
+			return;
+		}
+		written = m_written;
+		if ((fd = fcntl(m_libnorsim.getBackingFd(), F_DUPFD_CLOEXEC, 0)) < 0) {
+			restore(start, end);
+			return;
+		}
+	}
+
+	int ret = syncFile(fd, start, end);
+	m_libnorsim.getSyscallsCache().getSyscalls().closeSC(fd);
+
+	std::lock_guard<std::mutex> lg(m_libnorsim.getGlobalMutex());
+	if (0 != ret) {
+		restore(start, end);
+		return;
+	}
+	if (written > m_synced)
+		m_synced = written;
+	m_stats.syncs++;
+	m_stats.background++;
+}
+
+void SyncPolicy::wakeFlusher() {
+	{
+		std::lock_guard<std::mutex> lg(m_flusherMutex);
+		m_flushRequested = true;
+	}
+	m_flusherCond.notify_one();
+}
@@ -0,0 +1,78 @@
+#ifndef __SYNCPOLICY_H__
+#define __SYNCPOLICY_H__
+
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <thread>
+
+#include <sys/types.h>
+
+enum e_sync_mode_t {
+	E_SYNC_NONE = 0,
+	E_SYNC_CLOSE,
+	E_SYNC_OPS,
+	E_SYNC_MS,
+	E_SYNC_ERASE
+};
+
+struct st_sync_stats_t {
+	unsigned long requests;
+	unsigned long skipped;
+	unsigned long syncs;
+	unsigned long background;
+};
+
+class Libnorsim;
+
+// Durability of cache file. Range written by emulated writes and erases is
+// written out with sync_file_range() and made durable with fdatasync() on
+// close, after every erase, or by background flusher after given number of
+// operations or milliseconds. Sync requests of application (fsync() etc.)
+// return immediately when nothing was written since last sync, "none" mode
+// acknowledges them without syncing at all.
+class SyncPolicy {
+public:
+	SyncPolicy(Libnorsim &libnorsim, const e_sync_mode_t mode, const unsigned long interval);
+	~SyncPolicy();
+
+	e_sync_mode_t getMode() { return (m_mode); }
+	const char* getName();
+	const st_sync_stats_t& getStats() { return (m_stats); }
+
+	// called with global mutex held
+	void noteWrite(off_t offset, size_t count);
+	void noteErase(off_t offset, size_t count);
+	void noteClose();
+	int requestSync();
+
+private:
+	bool isDirty() { return (m_written != m_synced); }
+	bool collect(off_t &start, off_t &end);
+	void restore(off_t start, off_t end);
+	int syncLocked();
+	int syncFile(int fd, off_t start, off_t end);
+
+	void flusherMain();
+	void flushInBackground();
+	void wakeFlusher();
+
+	e_sync_mode_t m_mode;
+	unsigned long m_interval;
+	unsigned long m_pendingOps;
+	uint64_t m_written;
+	uint64_t m_synced;
+	off_t m_dirtyStart;
+	off_t m_dirtyEnd;
+	st_sync_stats_t m_stats;
+
+	std::thread m_flusher;
+	std::mutex m_flusherMutex;
+	std::condition_variable m_flusherCond;
+	bool m_flushRequested;
+	bool m_stop;
+
+	Libnorsim &m_libnorsim;
+};
+
+#endif // __SYNCPOLICY_H__
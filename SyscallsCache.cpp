@@ -9,6 +9,26 @@ SyscallsCache::SyscallsCache()
 {
 	if (NULL == (m_syscalls.openSC = reinterpret_cast<Syscalls::open_ptr_t>(dlsym(RTLD_NEXT, "open"))))
 		throw std::runtime_error("open");
+	if (NULL == (m_syscalls.openatSC = reinterpret_cast<Syscalls::openat_ptr_t>(dlsym(RTLD_NEXT, "openat"))))
+		throw std::runtime_error("openat");
+	if (NULL == (m_syscalls.fopenSC = reinterpret_cast<Syscalls::fopen_ptr_t>(dlsym(RTLD_NEXT, "fopen"))))
+		throw std::runtime_error("fopen");
+	if (NULL == (m_syscalls.fdopenSC = reinterpret_cast<Syscalls::fdopen_ptr_t>(dlsym(RTLD_NEXT, "fdopen"))))
+		throw std::runtime_error("fdopen");
+	if (NULL == (m_syscalls.sendfileSC = reinterpret_cast<Syscalls::sendfile_ptr_t>(dlsym(RTLD_NEXT, "sendfile"))))
+		throw std::runtime_error("sendfile");
+	if (NULL == (m_syscalls.sendfile64SC = reinterpret_cast<Syscalls::sendfile64_ptr_t>(dlsym(RTLD_NEXT, "sendfile64"))))
+		throw std::runtime_error("sendfile64");
+	if (NULL == (m_syscalls.spliceSC = reinterpret_cast<Syscalls::splice_ptr_t>(dlsym(RTLD_NEXT, "splice"))))
+		throw std::runtime_error("splice");
+	if (NULL == (m_syscalls.copyFileRangeSC = reinterpret_cast<Syscalls::copy_file_range_ptr_t>(dlsym(RTLD_NEXT, "copy_file_range"))))
+		throw std::runtime_error("copy_file_range");
+	if (NULL == (m_syscalls.fsyncSC = reinterpret_cast<Syscalls::fsync_ptr_t>(dlsym(RTLD_NEXT, "fsync"))))
+		throw std::runtime_error("fsync");
+	if (NULL == (m_syscalls.fdatasyncSC = reinterpret_cast<Syscalls::fsync_ptr_t>(dlsym(RTLD_NEXT, "fdatasync"))))
+		throw std::runtime_error("fdatasync");
+	if (NULL == (m_syscalls.syncfsSC = reinterpret_cast<Syscalls::fsync_ptr_t>(dlsym(RTLD_NEXT, "syncfs"))))
+		throw std::runtime_error("syncfs");
 	if (NULL == (m_syscalls.closeSC = reinterpret_cast<Syscalls::close_ptr_t>(dlsym(RTLD_NEXT, "close"))))
 		throw std::runtime_error("close");
 	if (NULL == (m_syscalls.preadSC = reinterpret_cast<Syscalls::pread_ptr_t>(dlsym(RTLD_NEXT, "pread"))))
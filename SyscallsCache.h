@@ -1,13 +1,25 @@
 #ifndef __SYSCALLSCACHE_H__
 #define __SYSCALLSCACHE_H__
 
+#include <cstdarg>
+#include <cstdio>
+
 #include <errno.h>
+#include <fcntl.h>
 #include <sys/stat.h>
 
 class SyscallsCache {
 	class Syscalls {
 	public:
 		typedef int (*open_ptr_t)(const char *path, int oflag, ...);
+		typedef int (*openat_ptr_t)(int dirfd, const char *path, int oflag, ...);
+		typedef FILE* (*fopen_ptr_t)(const char *path, const char *mode);
+		typedef FILE* (*fdopen_ptr_t)(int fd, const char *mode);
+		typedef ssize_t (*sendfile_ptr_t)(int out_fd, int in_fd, off_t *offset, size_t count);
+		typedef ssize_t (*sendfile64_ptr_t)(int out_fd, int in_fd, off64_t *offset, size_t count);
+		typedef ssize_t (*splice_ptr_t)(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned flags);
+		typedef int (*fsync_ptr_t)(int fd);
+		typedef ssize_t (*copy_file_range_ptr_t)(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned flags);
 		typedef int (*close_ptr_t)(int fd);
 		typedef ssize_t (*pread_ptr_t)(int fd, void *buf, size_t count, off_t offset);
 		typedef ssize_t (*pwrite_ptr_t)(int fd, const void *buf, size_t count, off_t offset);
@@ -27,6 +39,16 @@ class SyscallsCache {
 		}
 
 		open_ptr_t openSC;
+		openat_ptr_t openatSC;
+		fopen_ptr_t fopenSC;
+		fdopen_ptr_t fdopenSC;
+		sendfile_ptr_t sendfileSC;
+		sendfile64_ptr_t sendfile64SC;
+		splice_ptr_t spliceSC;
+		copy_file_range_ptr_t copyFileRangeSC;
+		fsync_ptr_t fsyncSC;
+		fsync_ptr_t fdatasyncSC;
+		fsync_ptr_t syncfsSC;
 		close_ptr_t closeSC;
 		pread_ptr_t preadSC;
 		pwrite_ptr_t pwriteSC;
@@ -49,6 +71,20 @@ private:
 public:
 	int invokeOpen(const char *path, int oflag, mode_t mode)
 		{ return (m_syscalls.invoke<Syscalls::open_ptr_t>(m_syscalls.openSC, path, oflag, mode)); }
+	int invokeOpenat(int dirfd, const char *path, int oflag, mode_t mode)
+		{ return (m_syscalls.invoke<Syscalls::openat_ptr_t>(m_syscalls.openatSC, dirfd, path, oflag, mode)); }
+	FILE* invokeFopen(const char *path, const char *mode)
+		{ return (m_syscalls.invoke<Syscalls::fopen_ptr_t>(m_syscalls.fopenSC, path, mode)); }
+	FILE* invokeFdopen(int fd, const char *mode)
+		{ return (m_syscalls.invoke<Syscalls::fdopen_ptr_t>(m_syscalls.fdopenSC, fd, mode)); }
+	ssize_t invokeSendfile(int out_fd, int in_fd, off_t *offset, size_t count)
+		{ return (m_syscalls.invoke<Syscalls::sendfile_ptr_t>(m_syscalls.sendfileSC, out_fd, in_fd, offset, count)); }
+	ssize_t invokeSendfile64(int out_fd, int in_fd, off64_t *offset, size_t count)
+		{ return (m_syscalls.invoke<Syscalls::sendfile64_ptr_t>(m_syscalls.sendfile64SC, out_fd, in_fd, offset, count)); }
+	ssize_t invokeSplice(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned flags)
+		{ return (m_syscalls.invoke<Syscalls::splice_ptr_t>(m_syscalls.spliceSC, fd_in, off_in, fd_out, off_out, len, flags)); }
+	ssize_t invokeCopyFileRange(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned flags)
+		{ return (m_syscalls.invoke<Syscalls::copy_file_range_ptr_t>(m_syscalls.copyFileRangeSC, fd_in, off_in, fd_out, off_out, len, flags)); }
 	int invokeClose(int fd)
 		{ return (m_syscalls.invoke<Syscalls::close_ptr_t>(m_syscalls.closeSC, fd)); }
 	size_t invokePread(int fd, void *buf, size_t count, off_t offset)
@@ -59,8 +95,8 @@ public:
 		{ return (m_syscalls.invoke<Syscalls::read_ptr_t>(m_syscalls.readSC, fd, buf, count)); }
 	size_t invokeWrite(int fd, const void *buf, size_t count)
 		{ return (m_syscalls.invoke<Syscalls::write_ptr_t>(m_syscalls.writeSC, fd, buf, count)); }
-	int invokeIoctl(int fd, unsigned long request, va_list args)
-		{ return (m_syscalls.invoke<Syscalls::ioctl_ptr_t>(m_syscalls.ioctlSC, fd, request, args)); }
+	int invokeIoctl(int fd, unsigned long request, void *arg)
+		{ return (m_syscalls.invoke<Syscalls::ioctl_ptr_t>(m_syscalls.ioctlSC, fd, request, arg)); }
 };
 
 #endif // __SYSCALSSCACHE_H__
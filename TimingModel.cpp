@@ -0,0 +1,71 @@
+#include <cstring>
+
+#include "Libnorsim.h"
+#include "Logger.h"
+#include "TimingModel.h"
+
+thread_local uint64_t TimingModel::m_paceDeadline = 0;
+
+TimingModel::TimingModel(Libnorsim &libnorsim, const st_timing_t &timing, const e_timing_mode_t mode, const unsigned long acceleration)
+ : m_timing(timing), m_mode(mode), m_acceleration((acceleration)?(acceleration):(1)), m_paceTarget(0), m_libnorsim(libnorsim) {
+	memset(&m_clock, 0x00, sizeof(m_clock));
+	m_libnorsim.getLogger().log(Loglevel::INFO, "Set timing: byte program %lu-%luns, buffer program (%lu bytes) %lu-%luns",
+		false, m_timing.byteProgram.typ, m_timing.byteProgram.max, m_timing.bufferSize, m_timing.bufferProgram.typ, m_timing.bufferProgram.max);
+	m_libnorsim.getLogger().log(Loglevel::INFO, "Set timing: erase %lu-%luns, read %luns/kB", false,
+		m_timing.erase.typ, m_timing.erase.max, m_timing.readPerKByte);
+}
+
+// write is split to program buffer sized (and aligned) chunks, each one
+// is programmed with cheaper of byte and buffer programming
+uint64_t TimingModel::getProgramCost(const off_t offset, const size_t count, const st_page_t &page) {
+	uint64_t byte_time = scale(m_timing.byteProgram, page);
+	if (0 == m_timing.bufferSize)
+		return (count * byte_time);
+
+	uint64_t buffer_time = scale(m_timing.bufferProgram, page);
+	uint64_t cost = 0;
+	size_t done = 0;
+	while (done < count) {
+		size_t chunk = m_timing.bufferSize - ((offset + done) % m_timing.bufferSize);
+		if (chunk > count - done)
+			chunk = count - done;
+		cost += (chunk * byte_time < buffer_time)?(chunk * byte_time):(buffer_time);
+		done += chunk;
+	}
+	return (cost);
+}
+
+uint64_t TimingModel::scale(const st_timing_range_t &range, const st_page_t &page) {
+	if ((E_PAGE_WEAK != page.type) || (0 == page.limit) || (range.max <= range.typ))
+		return (range.typ);
+	if (page.erases >= page.limit)
+		return (range.max);
+	return (range.typ + (range.max - range.typ) * page.erases / page.limit);
+}
+
+// pace target isn't moved back by idle time, small costs are accumulated until they are worth sleeping
+void TimingModel::advance(const uint64_t cost, const bool pace) {
+	m_clock.now += cost;
+	if ((E_TIMING_VIRTUAL == m_mode) || !pace)
+		return;
+
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	uint64_t now = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	if (m_paceTarget < now)
+		m_paceTarget = now;
+	m_paceTarget += cost / m_acceleration;
+	if (m_paceTarget - now >= TIMING_SLACK_NS)
+		m_paceDeadline = m_paceTarget;
+}
+
+void TimingModel::pace() {
+	if (0 == m_paceDeadline)
+		return;
+
+	struct timespec ts;
+	ts.tv_sec = m_paceDeadline / 1000000000ULL;
+	ts.tv_nsec = m_paceDeadline % 1000000000ULL;
+	m_paceDeadline = 0;
+	while (EINTR == clock_nanosleep(CLOCK_MONOTONIC, TIMER_ABSTIME, &ts, NULL));
+}
@@ -0,0 +1,88 @@
+#ifndef __TIMINGMODEL_H__
+#define __TIMINGMODEL_H__
+
+// operations are paced only when they are this much ahead of real time
+#define TIMING_SLACK_NS 100000ULL
+
+// defaults of parameters not given in NS_TIMING
+#define TIMING_DEFAULT_BYTE_TYP_US   10
+#define TIMING_DEFAULT_BYTE_MAX_US   200
+#define TIMING_DEFAULT_BUFFER_SIZE   256
+#define TIMING_DEFAULT_BUFFER_TYP_US 250
+#define TIMING_DEFAULT_BUFFER_MAX_US 1000
+#define TIMING_DEFAULT_ERASE_TYP_MS  400
+#define TIMING_DEFAULT_ERASE_MAX_MS  2000
+#define TIMING_DEFAULT_READ_MBPS     50
+
+#include <cstdint>
+#include <ctime>
+
+#include <sys/types.h>
+
+#include "libnorsim_ioctl.h"
+#include "PageManager.h"
+
+enum e_timing_mode_t {
+	E_TIMING_VIRTUAL = 0,
+	E_TIMING_REAL
+};
+
+// typical time is used for fresh blocks, it grows to max one as weak block wears out
+struct st_timing_range_t {
+	uint64_t typ;
+	uint64_t max;
+};
+
+// all times in ns
+struct st_timing_t {
+	st_timing_range_t byteProgram;
+	st_timing_range_t bufferProgram;
+	unsigned long bufferSize;
+	st_timing_range_t erase;
+	// ns per 1000 bytes read (10^6 / throughput in MB/s)
+	uint64_t readPerKByte;
+};
+
+class Libnorsim;
+
+// NOR timing model with virtual clock advanced by cost of every emulated
+// operation (device is busy with one operation at a time). Clock can be
+// only counted (virtual) or operations are paced so wall time follows it,
+// optionally accelerated. Idle time of application isn't credited.
+class TimingModel {
+public:
+	TimingModel(Libnorsim &libnorsim, const st_timing_t &timing, const e_timing_mode_t mode, const unsigned long acceleration);
+
+	e_timing_mode_t getMode() { return (m_mode); }
+	unsigned long getAcceleration() { return (m_acceleration); }
+	const st_timing_t& getTiming() { return (m_timing); }
+	const struct norsim_clock& getClock() { return (m_clock); }
+
+	uint64_t getReadCost(const size_t count) { return (count * m_timing.readPerKByte / 1000); }
+	uint64_t getProgramCost(const off_t offset, const size_t count, const st_page_t &page);
+	uint64_t getEraseCost(const st_page_t &page) { return (scale(m_timing.erase, page)); }
+	// real time matching given device time (0 in virtual mode)
+	uint64_t getRealTime(const uint64_t cost) { return ((E_TIMING_VIRTUAL == m_mode)?(0):(cost / m_acceleration)); }
+
+	// called with global mutex held for successful operations, pacing only sets deadline of calling thread
+	void chargeRead(const uint64_t cost) { m_clock.read += cost; advance(cost, true); }
+	void chargeProgram(const uint64_t cost) { m_clock.program += cost; advance(cost, true); }
+	void chargeErase(const uint64_t cost, const bool pace) { m_clock.erase += cost; advance(cost, pace); }
+	// sleeps until deadline of calling thread, called without global mutex and block locks
+	void pace();
+
+private:
+	uint64_t scale(const st_timing_range_t &range, const st_page_t &page);
+	void advance(const uint64_t cost, const bool pace);
+
+	st_timing_t m_timing;
+	e_timing_mode_t m_mode;
+	unsigned long m_acceleration;
+	struct norsim_clock m_clock;
+	uint64_t m_paceTarget;
+	static thread_local uint64_t m_paceDeadline;
+
+	Libnorsim &m_libnorsim;
+};
+
+#endif // __TIMINGMODEL_H__
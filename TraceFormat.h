@@ -0,0 +1,83 @@
+#ifndef __TRACEFORMAT_H__
+#define __TRACEFORMAT_H__
+
+// Binary operation trace: st_trace_header_t followed by data area holding
+// records, each record is followed by "payload" bytes (padded to 8 bytes).
+// In ring mode records between "first" and "end" are valid, a record which
+// would cross end of data area is preceded by TRACE_OP_WRAP (or by less than
+// sizeof(st_trace_record_t) bytes left) and is stored at data area start.
+
+#include <stdint.h>
+#include <string.h>
+
+#define TRACE_MAGIC   "NSTR"
+#define TRACE_VERSION 1
+
+#define TRACE_FLAG_HASH    0x01
+#define TRACE_FLAG_PAYLOAD 0x02
+#define TRACE_FLAG_RING    0x04
+
+#define TRACE_ALIGN(x) (((x) + 7) & ~((uint64_t)7))
+
+enum e_trace_op_t {
+	TRACE_OP_WRAP = 0,
+	TRACE_OP_OPEN,
+	TRACE_OP_CLOSE,
+	TRACE_OP_PREAD,
+	TRACE_OP_PWRITE,
+	TRACE_OP_GETINFO,
+	TRACE_OP_UNLOCK,
+	TRACE_OP_ERASE,
+	TRACE_OP_IOCTL
+};
+
+enum e_trace_fault_t {
+	TRACE_FAULT_NONE = 0,
+	TRACE_FAULT_EIO,
+	TRACE_FAULT_RND,
+	TRACE_FAULT_POWER
+};
+
+struct st_trace_header_t {
+	char magic[4];
+	uint32_t version;
+	uint64_t size;
+	uint32_t erase_size;
+	uint32_t flags;
+	uint64_t start_time;  // CLOCK_REALTIME [ns] when tracing started
+	uint64_t data_size;   // size of data area
+	uint64_t first;       // offset of oldest record in data area
+	uint64_t end;         // offset past newest record in data area
+	uint64_t records;     // number of records written (including overwritten ones)
+	uint64_t live;        // number of records available starting from "first"
+};
+
+struct st_trace_record_t {
+	uint64_t timestamp;   // [ns] since start_time
+	uint64_t offset;      // file offset, ioctl request for TRACE_OP_IOCTL
+	uint64_t hash;        // trace_hash() of data written/read (TRACE_FLAG_HASH)
+	uint32_t length;
+	uint32_t block;
+	int32_t result;
+	uint32_t payload;     // data bytes following record (TRACE_FLAG_PAYLOAD)
+	uint8_t op;
+	uint8_t fault;
+	uint16_t reserved[3];
+};
+
+// FNV-1a applied to 64-bit words (bytes for the tail)
+static inline uint64_t trace_hash(const void *data, uint64_t size)
+{
+	const unsigned char *ptr = (const unsigned char*)data;
+	uint64_t hash = 0xCBF29CE484222325ULL;
+	uint64_t word;
+	for (; size >= sizeof(word); size -= sizeof(word), ptr += sizeof(word)) {
+		memcpy(&word, ptr, sizeof(word));
+		hash = (hash ^ word) * 0x100000001B3ULL;
+	}
+	for (; size; --size, ++ptr)
+		hash = (hash ^ *ptr) * 0x100000001B3ULL;
+	return (hash);
+}
+
+#endif // __TRACEFORMAT_H__
@@ -0,0 +1,163 @@
+#include <cstring>
+#include <ctime>
+
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+
+#include "TraceRecorder.h"
+#include "Libnorsim.h"
+#include "Logger.h"
+
+TraceRecorder::TraceRecorder(Libnorsim &libnorsim, const char *path, const uint64_t ringSize, const uint32_t flags)
+ : m_flags(flags), m_header(NULL), m_data(NULL), m_mapSize(0), m_live(0), m_fault(TRACE_FAULT_NONE), m_libnorsim(libnorsim) {
+	uint64_t data_size = (ringSize)?(ringSize):(TRACE_CHUNK_SIZE);
+	if (ringSize)
+		m_flags |= TRACE_FLAG_RING;
+
+	m_fd = m_libnorsim.getSyscallsCache().invokeOpen(path, O_RDWR | O_CREAT | O_TRUNC | O_CLOEXEC, 0644);
+	if (m_fd < 0) {
+		m_libnorsim.getLogger().log(Loglevel::ERROR, "Couldn't create trace file: %s", false, path);
+		return;
+	}
+	m_mapSize = sizeof(st_trace_header_t) + data_size;
+	if (ftruncate(m_fd, m_mapSize) < 0) {
+		m_libnorsim.getLogger().log(Loglevel::ERROR, "Couldn't resize trace file: %s", false, path);
+		return;
+	}
+	void *map = mmap(NULL, m_mapSize, PROT_READ | PROT_WRITE, MAP_SHARED, m_fd, 0);
+	if (MAP_FAILED == map) {
+		m_libnorsim.getLogger().log(Loglevel::ERROR, "Couldn't map trace file: %s", false, path);
+		return;
+	}
+	m_header = static_cast<st_trace_header_t*>(map);
+	m_data = reinterpret_cast<char*>(&m_header[1]);
+
+	struct timespec ts;
+	clock_gettime(CLOCK_REALTIME, &ts);
+	memset(m_header, 0x00, sizeof(st_trace_header_t));
+	memcpy(m_header->magic, TRACE_MAGIC, sizeof(m_header->magic));
+	m_header->version = TRACE_VERSION;
+	m_header->size = m_libnorsim.getSize();
+	m_header->erase_size = m_libnorsim.getEraseSize();
+	m_header->flags = m_flags;
+	m_header->start_time = ts.tv_sec * 1000000000ULL + ts.tv_nsec;
+	m_header->data_size = data_size;
+	m_startTime = 0;
+	m_startTime = getTimestamp();
+
+	m_libnorsim.getLogger().log(Loglevel::INFO, "Set trace file: %s (%s, data: %s)", false, path,
+		(m_flags & TRACE_FLAG_RING)?("ring"):("file"),
+		(m_flags & TRACE_FLAG_PAYLOAD)?("payload"):((m_flags & TRACE_FLAG_HASH)?("hash"):("none"))
+	);
+}
+
+TraceRecorder::~TraceRecorder() {
+	if (m_header) {
+		uint64_t used = m_mapSize;
+		if (!(m_flags & TRACE_FLAG_RING)) {
+			m_header->data_size = m_header->end;
+			used = sizeof(st_trace_header_t) + m_header->end;
+		}
+		munmap(m_header, m_mapSize);
+		if (ftruncate(m_fd, used) < 0)
+			m_libnorsim.getLogger().log(Loglevel::ERROR, "Couldn't truncate trace file");
+	}
+	if (m_fd >= 0)
+		m_libnorsim.getSyscallsCache().invokeClose(m_fd);
+}
+
+void TraceRecorder::record(const e_trace_op_t op, const uint64_t offset, const uint32_t length, const uint32_t block,
+	const int32_t result, const void *data, const size_t dataSize) {
+	if (!m_header)
+		return;
+
+	uint64_t payload = ((m_flags & TRACE_FLAG_PAYLOAD) && data)?(dataSize):(0);
+	uint64_t size = sizeof(st_trace_record_t) + TRACE_ALIGN(payload);
+	if ((m_flags & TRACE_FLAG_RING) && (size > m_header->data_size / 2)) {
+		payload = 0;
+		size = sizeof(st_trace_record_t);
+	}
+	if (!reserve(size))
+		return;
+
+	st_trace_record_t *rec = reinterpret_cast<st_trace_record_t*>(&m_data[m_header->end]);
+	memset(rec, 0x00, sizeof(st_trace_record_t));
+	rec->timestamp = getTimestamp() - m_startTime;
+	rec->offset = offset;
+	rec->hash = ((m_flags & TRACE_FLAG_HASH) && data)?(trace_hash(data, dataSize)):(0);
+	rec->length = length;
+	rec->block = block;
+	rec->result = result;
+	rec->payload = payload;
+	rec->op = op;
+	rec->fault = m_fault;
+	if (payload)
+		memcpy(&rec[1], data, payload);
+
+	m_fault = TRACE_FAULT_NONE;
+	m_header->end += size;
+	m_header->live = ++m_live;
+	m_header->records++;
+}
+
+bool TraceRecorder::reserve(const uint64_t size) {
+	uint64_t data_size = m_header->data_size;
+	uint64_t end = m_header->end;
+	if (end + size <= data_size) {
+		if (m_flags & TRACE_FLAG_RING)
+			discardOldest(end, size);
+		return (true);
+	}
+
+	if (m_flags & TRACE_FLAG_RING) {
+		// records left past the end are older than ones at data area start
+		discardOldest(end, data_size - end);
+		if (data_size - end >= sizeof(st_trace_record_t)) {
+			st_trace_record_t *wrap = reinterpret_cast<st_trace_record_t*>(&m_data[end]);
+			memset(wrap, 0x00, sizeof(st_trace_record_t));
+			wrap->op = TRACE_OP_WRAP;
+		}
+		m_header->end = 0;
+		discardOldest(0, size);
+		return (true);
+	}
+
+	while (data_size < end + size)
+		data_size *= 2;
+	size_t map_size = sizeof(st_trace_header_t) + data_size;
+	if (ftruncate(m_fd, map_size) < 0)
+		return (false);
+	void *map = mremap(m_header, m_mapSize, map_size, MREMAP_MAYMOVE);
+	if (MAP_FAILED == map)
+		return (false);
+	m_mapSize = map_size;
+	m_header = static_cast<st_trace_header_t*>(map);
+	m_data = reinterpret_cast<char*>(&m_header[1]);
+	m_header->data_size = data_size;
+	return (true);
+}
+
+// drops oldest records overlapping area which is going to be overwritten
+void TraceRecorder::discardOldest(const uint64_t pos, const uint64_t size) {
+	uint64_t first = m_header->first;
+	while ((m_live > 0) && (first >= pos) && (first < pos + size)) {
+		first += getRecordSize(first);
+		if ((m_header->data_size - first < sizeof(st_trace_record_t)) ||
+			(TRACE_OP_WRAP == reinterpret_cast<st_trace_record_t*>(&m_data[first])->op))
+			first = 0;
+		--m_live;
+	}
+	m_header->first = (m_live > 0)?(first):(pos);
+	m_header->live = m_live;
+}
+
+uint64_t TraceRecorder::getRecordSize(const uint64_t pos) {
+	return (sizeof(st_trace_record_t) + TRACE_ALIGN(reinterpret_cast<st_trace_record_t*>(&m_data[pos])->payload));
+}
+
+uint64_t TraceRecorder::getTimestamp() {
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
@@ -0,0 +1,47 @@
+#ifndef __TRACERECORDER_H__
+#define __TRACERECORDER_H__
+
+#define TRACE_CHUNK_SIZE    (4 * 1024 * 1024)
+#define TRACE_RING_MIN_SIZE (64 * 1024)
+
+#include <cstddef>
+#include <cstdint>
+
+#include "TraceFormat.h"
+
+class Libnorsim;
+
+// Appends binary records of operations on cache file to memory mapped file,
+// growing it as needed or wrapping around in ring mode
+class TraceRecorder {
+public:
+	TraceRecorder(Libnorsim &libnorsim, const char *path, const uint64_t ringSize, const uint32_t flags);
+	~TraceRecorder();
+
+	bool isOk() { return (NULL != m_header); }
+
+	// fault injected by currently handled operation, consumed by record()
+	void setFault(const e_trace_fault_t fault) { m_fault = fault; }
+
+	void record(const e_trace_op_t op, const uint64_t offset, const uint32_t length, const uint32_t block,
+		const int32_t result, const void *data = NULL, const size_t dataSize = 0);
+
+private:
+	bool reserve(const uint64_t size);
+	void discardOldest(const uint64_t pos, const uint64_t size);
+	uint64_t getRecordSize(const uint64_t pos);
+	uint64_t getTimestamp();
+
+	int m_fd;
+	uint32_t m_flags;
+	st_trace_header_t *m_header;
+	char *m_data;
+	size_t m_mapSize;
+	uint64_t m_live;
+	uint64_t m_startTime;
+	e_trace_fault_t m_fault;
+
+	Libnorsim &m_libnorsim;
+};
+
+#endif // __TRACERECORDER_H__
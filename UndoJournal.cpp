@@ -0,0 +1,42 @@
+#include <cstring>
+
+#include "UndoJournal.h"
+
+// records are kept aligned, so they can be accessed in place
+#define UNDO_ALIGN(x) (((x) + alignof(st_undo_record_t) - 1) & ~(alignof(st_undo_record_t) - 1))
+
+unsigned long UndoJournal::getCheckpoint() {
+	startEpoch();
+	return (m_offsets.size());
+}
+
+const st_undo_record_t* UndoJournal::getLast() {
+	if (m_offsets.empty())
+		return (NULL);
+	return (reinterpret_cast<const st_undo_record_t*>(&m_data[m_offsets.back()]));
+}
+
+void UndoJournal::dropLast() {
+	m_data.resize(m_offsets.back());
+	m_offsets.pop_back();
+}
+
+void UndoJournal::addPage(const unsigned index, const st_page_t &page) {
+	addData(index, 0, 0);
+	st_undo_record_t *rec = reinterpret_cast<st_undo_record_t*>(&m_data[m_offsets.back()]);
+	memcpy(&rec->page, &page, sizeof(st_page_t));
+	m_epochs[index] = m_epoch;
+}
+
+char* UndoJournal::addData(const unsigned index, const unsigned offset, const unsigned length) {
+	size_t start = m_data.size();
+	m_data.resize(start + UNDO_ALIGN(sizeof(st_undo_record_t) + length));
+	m_offsets.push_back(start);
+
+	st_undo_record_t *rec = reinterpret_cast<st_undo_record_t*>(&m_data[start]);
+	memset(rec, 0x00, sizeof(st_undo_record_t));
+	rec->index = index;
+	rec->offset = offset;
+	rec->length = length;
+	return (reinterpret_cast<char*>(&rec[1]));
+}
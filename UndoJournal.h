@@ -0,0 +1,51 @@
+#ifndef __UNDOJOURNAL_H__
+#define __UNDOJOURNAL_H__
+
+#include <cstdint>
+#include <vector>
+
+#include "PageManager.h"
+
+// old contents of range of block (length > 0) or old state of page
+struct st_undo_record_t {
+	unsigned index;
+	unsigned offset;
+	unsigned length;
+	st_page_t page;
+};
+
+// Write-ahead undo log of device: contents are recorded before every change,
+// page state once per checkpoint interval (before its first change). Checkpoint
+// is number of records, rolling back to it undoes newer records (newest first).
+class UndoJournal {
+public:
+	UndoJournal(const unsigned pageCount)
+	 : m_epoch(1), m_epochs(pageCount, 0) {}
+
+	unsigned long getCheckpoint();
+	unsigned long getRecordCount() { return (m_offsets.size()); }
+	unsigned long getDataSize() { return (m_data.size()); }
+
+	void notePage(const unsigned index, const st_page_t &page) {
+		if (m_epochs[index] != m_epoch)
+			addPage(index, page);
+	}
+	// returns buffer (valid until next change of journal) where old contents have to be stored
+	char* addData(const unsigned index, const unsigned offset, const unsigned length);
+
+	// newest record (NULL if there are none), data follows it
+	const st_undo_record_t* getLast();
+	void dropLast();
+	// pages have to be recorded again after rollback
+	void startEpoch() { m_epoch++; }
+
+private:
+	void addPage(const unsigned index, const st_page_t &page);
+
+	unsigned m_epoch;
+	std::vector<unsigned> m_epochs;
+	std::vector<size_t> m_offsets;
+	std::vector<char> m_data;
+};
+
+#endif // __UNDOJOURNAL_H__
@@ -0,0 +1,247 @@
+// Micro-benchmarks of libnorsim overhead ("make bench"), libnorsim is linked as first needed
+// library and interposes I/O without being preloaded, NS_* variables already present in
+// environment take precedence over defaults below
+
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <ctime>
+#include <functional>
+#include <memory>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+
+#include <mtd/mtd-user.h>
+
+#include "Histogram.h"
+#include "Libnorsim.h"
+#include "PageManager.h"
+
+#define BENCH_CACHE_FILE  "/tmp/norsim-bench"
+#define BENCH_SIZE        "16384"
+#define BENCH_ERASE_SIZE  "64"
+#define BENCH_DURATION_MS 500
+#define BENCH_PAGE_COUNT  (4 * 1024 * 1024)
+#define BENCH_BATCH       64
+
+struct st_bench_t {
+	std::string name;
+	// number of operations performed by single call of "op"
+	unsigned batch;
+	std::function<void()> op;
+};
+
+struct st_bench_opts_t {
+	unsigned duration;
+	unsigned pageCount;
+	const char *filter;
+	const char *output;
+};
+
+static uint64_t get_time_ns()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return (ts.tv_sec * 1000000000ULL + ts.tv_nsec);
+}
+
+static void print_usage(const char *name)
+{
+	printf("usage: %s [options]\n", name);
+	puts("options:");
+	puts("\t-d <ms>\t\tduration of each benchmark (default: 500)");
+	puts("\t-p <pages>\tpage count used by page fault parser benchmarks (default: 4194304)");
+	puts("\t-f <filter>\trun only benchmarks which name contains given string");
+	puts("\t-o <file>\twrite results in tab separated format to given file");
+}
+
+// cache file has to exist before libnorsim initializes, which happens on first interposed call
+static bool prepare_environment()
+{
+	setenv("NS_CACHE_FILE", BENCH_CACHE_FILE, 0);
+	setenv("NS_SIZE", BENCH_SIZE, 0);
+	setenv("NS_ERASE_SIZE", BENCH_ERASE_SIZE, 0);
+	setenv("NS_LOG", "/dev/null", 0);
+
+	const char *path = getenv("NS_CACHE_FILE");
+	off_t size = strtoull(getenv("NS_SIZE"), NULL, 10) * 1024;
+	int fd = syscall(SYS_openat, AT_FDCWD, path, O_RDWR | O_CREAT | O_CLOEXEC, 0644);
+	if (fd < 0) {
+		printf("couldn't create cache file: %s\n", path);
+		return (false);
+	}
+	bool ok = (0 == ftruncate(fd, size));
+	syscall(SYS_close, fd);
+	return (ok);
+}
+
+static void add_bench(std::vector<st_bench_t> &benches, const std::string &name, unsigned batch, const std::function<void()> &op)
+{
+	benches.emplace_back();
+	benches.back().name = name;
+	benches.back().batch = batch;
+	benches.back().op = op;
+}
+
+static void run_bench(const st_bench_t &bench, const st_bench_opts_t &opts, FILE *output)
+{
+	Histogram histogram;
+	uint64_t deadline = get_time_ns() + opts.duration * 1000000ULL;
+	uint64_t total = 0;
+	uint64_t start, end;
+
+	bench.op();
+	do {
+		start = get_time_ns();
+		bench.op();
+		end = get_time_ns();
+		histogram.record((end - start) / bench.batch);
+		total += end - start;
+	} while (end < deadline);
+
+	uint64_t ops = histogram.getCount() * bench.batch;
+	double ops_per_sec = (total)?(ops * 1e9 / total):(0.0);
+	printf("%-28s %12lu %14.0f %8lu %8lu %8lu %8lu %8lu %10lu\n", bench.name.c_str(), ops, ops_per_sec,
+		histogram.getMin(), histogram.getPercentile(50.0), histogram.getPercentile(90.0),
+		histogram.getPercentile(99.0), histogram.getPercentile(99.9), histogram.getMax());
+	if (output) {
+		fprintf(output, "%s\t%lu\t%.0f\t%lu\t%lu\t%lu\t%lu\t%lu\t%lu\n", bench.name.c_str(), ops, ops_per_sec,
+			histogram.getMin(), histogram.getPercentile(50.0), histogram.getPercentile(90.0),
+			histogram.getPercentile(99.0), histogram.getPercentile(99.9), histogram.getMax());
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	st_bench_opts_t opts = {BENCH_DURATION_MS, BENCH_PAGE_COUNT, NULL, NULL};
+	int opt;
+
+	while (-1 != (opt = getopt(argc, argv, "d:p:f:o:h"))) {
+		switch (opt) {
+			case 'd': opts.duration = strtoul(optarg, NULL, 10); break;
+			case 'p': opts.pageCount = strtoul(optarg, NULL, 10); break;
+			case 'f': opts.filter = optarg; break;
+			case 'o': opts.output = optarg; break;
+			default: print_usage(argv[0]); return (1);
+		}
+	}
+	if ((0 == opts.duration) || (0 == opts.pageCount)) {
+		print_usage(argv[0]);
+		return (1);
+	}
+	if (!prepare_environment())
+		return (1);
+
+	int fd = open(getenv("NS_CACHE_FILE"), O_RDWR);
+	int null_fd = open("/dev/zero", O_RDWR);
+	if ((fd < 0) || (null_fd < 0)) {
+		puts("couldn't open device");
+		return (1);
+	}
+
+	Libnorsim &libnorsim = Libnorsim::getInstance();
+	const unsigned long erase_size = libnorsim.getEraseSize();
+	const unsigned long block_count = libnorsim.getSize() / erase_size;
+	std::vector<char> buf(erase_size, 0xFF);
+	std::vector<char> block(erase_size, 0xFF);
+	unsigned long next_block = 0;
+	mtd_info_t mtd_info;
+	erase_info_t ei;
+
+	NorGeometry single_geometry({{0, erase_size, 1}});
+	NorGeometry pages_geometry({{0, libnorsim.getEraseSize(), opts.pageCount}});
+	std::unique_ptr<PageManager> page_manager;
+	std::vector<st_bench_t> benches;
+
+	add_bench(benches, "passthrough_open_close", 1, [&]() {
+		close(open("/dev/null", O_RDONLY));
+	});
+	add_bench(benches, "passthrough_pread_4k", 1, [&]() {
+		pread(null_fd, buf.data(), 4096, 0);
+	});
+	add_bench(benches, "passthrough_pwrite_4k", 1, [&]() {
+		pwrite(null_fd, buf.data(), 4096, 0);
+	});
+	for (unsigned long size : {16UL, 512UL, 4096UL, erase_size}) {
+		if (size > erase_size)
+			continue;
+		add_bench(benches, "pread_" + std::to_string(size), 1, [&, size]() {
+			pread(fd, buf.data(), size, (next_block++ % block_count) * erase_size);
+		});
+		add_bench(benches, "pwrite_" + std::to_string(size), 1, [&, size]() {
+			pwrite(fd, buf.data(), size, (next_block++ % block_count) * erase_size);
+		});
+	}
+	add_bench(benches, "unlock_erase", 1, [&]() {
+		ei.start = (next_block++ % block_count) * erase_size;
+		ei.length = erase_size;
+		ioctl(fd, MEMUNLOCK, &ei);
+		ioctl(fd, MEMERASE, &ei);
+	});
+	add_bench(benches, "memgetinfo", 1, [&]() {
+		ioctl(fd, MEMGETINFO, &mtd_info);
+	});
+	add_bench(benches, "merge_bitmasks_" + std::to_string(erase_size), BENCH_BATCH, [&]() {
+		for (unsigned i = 0; i < BENCH_BATCH; ++i)
+			libnorsim.getPageManager().mergeBitMasks(0, erase_size, block.data(), buf.data());
+	});
+	add_bench(benches, "merge_bitmasks_checked_" + std::to_string(erase_size), BENCH_BATCH, [&]() {
+		st_program_check_t check;
+		memset(&check, 0x00, sizeof(check));
+		for (unsigned i = 0; i < BENCH_BATCH; ++i)
+			libnorsim.getPageManager().mergeBitMasks(0, erase_size, block.data(), buf.data(), check);
+	});
+	add_bench(benches, "set_bitmask", BENCH_BATCH, [&]() {
+		for (unsigned i = 0; i < BENCH_BATCH; ++i)
+			libnorsim.getPageManager().setBitMask(i % block_count, block.data());
+	});
+	add_bench(benches, "flip_bits_1e-5_" + std::to_string(erase_size), BENCH_BATCH, [&]() {
+		if (!page_manager) {
+			page_manager.reset(new PageManager(libnorsim.getLogger(), single_geometry, 1, NULL));
+			page_manager->parseBitErrorRate("base=0.00001");
+		}
+		for (unsigned i = 0; i < BENCH_BATCH; ++i)
+			page_manager->flipBits(0, block.data(), erase_size);
+	});
+	add_bench(benches, "parse_pages_list_" + std::to_string(opts.pageCount), 1, [&]() {
+		page_manager.reset(new PageManager(libnorsim.getLogger(), pages_geometry, 1, NULL));
+		page_manager->parseWeakPagesEnv("eio 0,10;1,10;2,10;3,10;4,10;5,10;6,10;7,10;");
+	});
+	add_bench(benches, "parse_pages_stride_" + std::to_string(opts.pageCount), 1, [&]() {
+		page_manager.reset(new PageManager(libnorsim.getLogger(), pages_geometry, 1, NULL));
+		page_manager->parseWeakPagesEnv("eio */7,1000;");
+	});
+	add_bench(benches, "parse_pages_pct_wbl_" + std::to_string(opts.pageCount), 1, [&]() {
+		page_manager.reset(new PageManager(libnorsim.getLogger(), pages_geometry, 1, NULL));
+		page_manager->parseWeakPagesEnv("eio *:10%,wbl:2:1000;");
+	});
+
+	FILE *output = NULL;
+	if (opts.output) {
+		if (NULL == (output = fopen(opts.output, "w"))) {
+			printf("couldn't open output file: %s\n", opts.output);
+			return (1);
+		}
+		fputs("# name\tops\tops_per_sec\tmin_ns\tp50_ns\tp90_ns\tp99_ns\tp999_ns\tmax_ns\n", output);
+	}
+
+	printf("%-28s %12s %14s %8s %8s %8s %8s %8s %10s\n", "benchmark [ns]", "ops", "ops/s",
+		"min", "p50", "p90", "p99", "p99.9", "max");
+	for (const st_bench_t &bench : benches) {
+		if ((NULL == opts.filter) || (std::string::npos != bench.name.find(opts.filter)))
+			run_bench(bench, opts, output);
+	}
+	page_manager.reset();
+
+	if (output)
+		fclose(output);
+	close(null_fd);
+	close(fd);
+	return (0);
+}
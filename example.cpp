@@ -0,0 +1,65 @@
+// Example of flash device embedded in process through libnorsim-core, without
+// preloaded libnorsim: device kept in memory with weak page, which fails once
+// erased more times than its limit
+//
+// build: make norsim-example
+// run: LD_LIBRARY_PATH=. ./norsim-example
+
+#include <cerrno>
+#include <cstdio>
+#include <cstring>
+
+#include "NorDevice.h"
+
+#define EXAMPLE_SIZE 65536
+#define EXAMPLE_ERASE_SIZE 256
+#define EXAMPLE_WEAK_LIMIT 2
+
+int main()
+{
+	st_nor_config_t config;
+	memset(&config, 0, sizeof(config));
+	config.size = EXAMPLE_SIZE;
+	config.eraseSize = EXAMPLE_ERASE_SIZE;
+	config.seed = 1;
+	config.programCheck = true;
+
+	NorDevice device(config);
+	device.setPageFault(1, E_PAGE_WEAK, EXAMPLE_WEAK_LIMIT, E_BEH_EIO);
+	printf("device: size=%lu, erase size=%lu, pages=%u\n", device.getSize(), device.getEraseSize(), device.getPageCount());
+
+	char data[EXAMPLE_ERASE_SIZE];
+	char buf[EXAMPLE_ERASE_SIZE];
+	memset(data, 0xA5, sizeof(data));
+
+	// blocks are locked after power on and again by erase
+	int ret = device.erase(0, EXAMPLE_ERASE_SIZE);
+	printf("erase locked block: ret=%d, errno=%d (%s)\n", ret, errno, strerror(errno));
+
+	device.unlock(0, EXAMPLE_ERASE_SIZE);
+	device.erase(0, EXAMPLE_ERASE_SIZE);
+	device.program(data, sizeof(data), 0);
+	device.read(buf, sizeof(buf), 0);
+	printf("program and read back: %s\n", (0 == memcmp(data, buf, sizeof(buf)))?("match"):("mismatch"));
+
+	// program only clears bits
+	memset(data, 0x0F, sizeof(data));
+	device.program(data, sizeof(data), 0);
+	device.read(buf, sizeof(buf), 0);
+	printf("second program: 0x%02X\n", static_cast<unsigned char>(buf[0]));
+
+	for (unsigned cycle = 1; cycle <= EXAMPLE_WEAK_LIMIT + 1; ++cycle) {
+		device.unlock(EXAMPLE_ERASE_SIZE, EXAMPLE_ERASE_SIZE);
+		ret = device.erase(EXAMPLE_ERASE_SIZE, EXAMPLE_ERASE_SIZE);
+		printf("erase weak page, cycle %u: ret=%d", cycle, ret);
+		if (0 != ret)
+			printf(", errno=%d (%s)", errno, strerror(errno));
+		printf("\n");
+	}
+
+	const st_nor_stats_t &stats = device.getStats();
+	const st_program_stats_t &totals = device.getProgramTotals();
+	printf("stats: reads=%lu, programs=%lu, erases=%lu, faults=%lu\n", stats.reads, stats.programs, stats.erases, stats.faults);
+	printf("programs: bytes=%lu, programmed bits=%lu, illegal bits=%lu\n", totals.bytes, totals.programmedBits, totals.illegalBits);
+	return (0);
+}
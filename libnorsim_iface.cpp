@@ -1,15 +1,22 @@
+#include <cstdio>
 #include <cstring>
 
+#include <dlfcn.h>
+#include <fcntl.h>
 #include <unistd.h>
 #include <signal.h>
 
 #include <sys/file.h>
 #include <sys/ioctl.h>
+#include <sys/sendfile.h>
+#include <sys/stat.h>
 
 #include <mtd/mtd-user.h>
 
 #include "Libnorsim.h"
+#include "libnorsim_ioctl.h"
 #include "Logger.h"
+#include "Probes.h"
 
 #define SYSCALL_PROLOGUE(syscall) \
 	do { \
@@ -17,59 +24,203 @@
 		instance.getLogger().log(Loglevel::DEBUG, "handling syscall: %s", false, syscall); \
 	} while (0)
 
+#define OPEN_GET_MODE(oflag, mode) \
+	mode_t mode = 0; \
+	do { \
+		if (((oflag) & O_CREAT) || (O_TMPFILE == ((oflag) & O_TMPFILE))) { \
+			va_list args; \
+			va_start(args, oflag); \
+			mode = va_arg(args, mode_t); \
+			va_end(args); \
+		} \
+	} while (0)
+
+// emulated stdio stream on cache file
+struct st_stdio_cookie_t {
+	int fd;
+	off64_t position;
+};
+
+// zero-copy transfer of clean range from cache file, in_off is always given
+typedef ssize_t (*bulk_copy_t)(Libnorsim &libnorsim, int in_fd, loff_t *in_off, int out_fd, loff_t *out_off, size_t len, unsigned flags);
+
+// next definition of interposed function, used while Libnorsim (with its SyscallsCache) is constructed
+template<typename T>
+static T get_next(const char *name) {
+	return (reinterpret_cast<T>(dlsym(RTLD_NEXT, name)));
+}
+
+// holds locks of given blocks in scope, when device is shared with other processes
+class BlockLock {
+public:
+	BlockLock(Libnorsim &libnorsim, const unsigned first, const unsigned count)
+	 : m_shared(libnorsim.getSharedDevice()), m_first(first), m_count(count) {
+		if (NULL != m_shared)
+			m_shared->lock(m_first, m_count);
+	}
+	~BlockLock() {
+		if (NULL != m_shared)
+			m_shared->unlock(m_first, m_count);
+	}
+
+private:
+	SharedDevice *m_shared;
+	unsigned m_first;
+	unsigned m_count;
+};
+
+// paces calling thread when leaving scope, declared before guard of global mutex
+// so other threads aren't stalled while device time passes
+class PaceGuard {
+public:
+	PaceGuard(Libnorsim &libnorsim) : m_timing(libnorsim.getTimingModel()) {}
+	~PaceGuard() {
+		if (NULL != m_timing)
+			m_timing->pace();
+	}
+
+private:
+	TimingModel *m_timing;
+};
+
 extern "C" {
 
 volatile sig_atomic_t report_requested = 0;
+volatile sig_atomic_t reload_requested = 0;
+
+static int open_common(int dirfd, const char *path, int oflag, mode_t mode);
+static int open_cache_file(Libnorsim &libnorsim, const char *path, int oflag, uint64_t start);
+static FILE* fopen_common(const char *path, const char *mode);
+static FILE* stdio_open(Libnorsim &libnorsim, int fd, const char *mode);
+static ssize_t stdio_read(void *cookie, char *buf, size_t size);
+static ssize_t stdio_write(void *cookie, const char *buf, size_t size);
+static int stdio_seek(void *cookie, off64_t *offset, int whence);
+static int stdio_close(void *cookie);
+
+static int sync_common(int fd, const char *name, int (*real)(int fd));
+
+static ssize_t bulk_common(int in_fd, loff_t *in_off, int out_fd, loff_t *out_off, size_t len, unsigned flags, bulk_copy_t copy);
+static ssize_t bulk_transfer(Libnorsim &libnorsim, int in_fd, loff_t *in_off, int out_fd, loff_t *out_off, size_t len, unsigned flags, bulk_copy_t copy);
+static ssize_t bulk_sendfile(Libnorsim &libnorsim, int in_fd, loff_t *in_off, int out_fd, loff_t *out_off, size_t len, unsigned flags);
+static ssize_t bulk_splice(Libnorsim &libnorsim, int in_fd, loff_t *in_off, int out_fd, loff_t *out_off, size_t len, unsigned flags);
+static ssize_t bulk_copy_file_range(Libnorsim &libnorsim, int in_fd, loff_t *in_off, int out_fd, loff_t *out_off, size_t len, unsigned flags);
 
 static int internal_open(Libnorsim &libnorsim, const char *path, int oflag, mode_t mode);
 static int internal_close(Libnorsim &libnorsim, int fd);
 static int internal_pread(Libnorsim &libnorsim, int fd, void *buf, size_t count, off_t offset);
 static int internal_pwrite(Libnorsim &libnorsim, int fd, const void *buf, size_t count, off_t offset);
 static int internal_ioctl(Libnorsim &libnorsim, int fd, unsigned long request, va_list args);
+static int internal_ioctl_batch(Libnorsim &libnorsim, int fd, va_list args);
+static int internal_ioctl_age(Libnorsim &libnorsim, va_list args);
+static int internal_ioctl_power_cut(Libnorsim &libnorsim, va_list args);
+static int internal_ioctl_power_on(Libnorsim &libnorsim);
+static int internal_ioctl_checkpoint(Libnorsim &libnorsim, va_list args);
+static int internal_ioctl_rollback(Libnorsim &libnorsim, va_list args);
+static int internal_ioctl_memunlock(Libnorsim &libnorsim, const erase_info_t *ei);
+static int internal_ioctl_memgetregioncount(Libnorsim &libnorsim, va_list args);
+static int internal_ioctl_memgetregioninfo(Libnorsim &libnorsim, va_list args);
+static int internal_ioctl_memerase(Libnorsim &libnorsim, const erase_info_t *ei);
+static int batch_op(Libnorsim &libnorsim, int fd, struct norsim_op &op);
+
+static int erase_blocks(Libnorsim &libnorsim, const unsigned first, const unsigned count);
+static int erase_job(Libnorsim &libnorsim, const unsigned first, const unsigned count);
+
+static bool block_access(Libnorsim &libnorsim, const unsigned index);
+
+static bool is_erase_info_valid(Libnorsim &libnorsim, const erase_info_t *ei);
+
+static void trace_op(Libnorsim &libnorsim, const e_trace_op_t op, off_t offset, size_t length, int result, const void *data, size_t dataSize);
+static void trace_ioctl(Libnorsim &libnorsim, unsigned long request, va_list args, int result);
+
+static uint64_t latency_start(Libnorsim &libnorsim);
+static void latency_op(Libnorsim &libnorsim, const e_lat_op_t op, uint64_t start);
+static void latency_phase(Libnorsim &libnorsim, const e_lat_phase_t phase, uint64_t start);
 
 int open(const char *path, int oflag, ...) {
-	Libnorsim &instance = Libnorsim::getInstance();
-	std::lock_guard<std::mutex> lg(instance.getGlobalMutex());
-	instance.handleReportRequest();
+	OPEN_GET_MODE(oflag, mode);
+	return (open_common(AT_FDCWD, path, oflag, mode));
+}
 
-	mode_t mode;
-	va_list args;
-	va_start(args, oflag);
-	if (oflag & O_CREAT)
-		mode = va_arg(args, mode_t);
-	else
-		mode = 0;
-	va_end(args);
+int open64(const char *path, int oflag, ...) {
+	OPEN_GET_MODE(oflag, mode);
+	return (open_common(AT_FDCWD, path, oflag, mode));
+}
 
-	instance.getLogger().log(Loglevel::DEBUG, "handling open(path=%s, oflag=0x%X, mode=0x%X)", false, path, oflag, mode);
-	int res;
+int openat(int dirfd, const char *path, int oflag, ...) {
+	OPEN_GET_MODE(oflag, mode);
+	return (open_common(dirfd, path, oflag, mode));
+}
 
-	char *realpath_buf = realpath(path, NULL);
+int openat64(int dirfd, const char *path, int oflag, ...) {
+	OPEN_GET_MODE(oflag, mode);
+	return (open_common(dirfd, path, oflag, mode));
+}
 
-	if ((NULL == realpath_buf) || (0 != strcmp(realpath_buf, instance.getCacheFile())))
-		res = instance.getSyscallsCache().invokeOpen(path, oflag, mode);
-	else
-		res = internal_open(instance, path, oflag, mode);
+int creat(const char *path, mode_t mode) {
+	return (open_common(AT_FDCWD, path, O_CREAT | O_WRONLY | O_TRUNC, mode));
+}
 
-	free(realpath_buf);
-	realpath_buf = NULL;
+int creat64(const char *path, mode_t mode) {
+	return (open_common(AT_FDCWD, path, O_CREAT | O_WRONLY | O_TRUNC, mode));
+}
 
-	instance.getLogger().log(Loglevel::DEBUG, "open: return=%d", false, res);
+// _FORTIFY_SOURCE variants
+int __open_2(const char *path, int oflag) {
+	return (open_common(AT_FDCWD, path, oflag, 0));
+}
 
-	return (res);
+int __open64_2(const char *path, int oflag) {
+	return (open_common(AT_FDCWD, path, oflag, 0));
+}
+
+int __openat_2(int dirfd, const char *path, int oflag) {
+	return (open_common(dirfd, path, oflag, 0));
+}
+
+int __openat64_2(int dirfd, const char *path, int oflag) {
+	return (open_common(dirfd, path, oflag, 0));
+}
+
+FILE* fopen(const char *path, const char *mode) {
+	return (fopen_common(path, mode));
+}
+
+FILE* fopen64(const char *path, const char *mode) {
+	return (fopen_common(path, mode));
+}
+
+FILE* fdopen(int fd, const char *mode) {
+	if (Libnorsim::isConstructing())
+		return (get_next<decltype(&fdopen)>("fdopen")(fd, mode));
+
+	Libnorsim &instance = Libnorsim::getInstance();
+	bool emulated;
+	{
+		std::lock_guard<std::mutex> lg(instance.getGlobalMutex());
+		emulated = instance.isOpened() && (fd == instance.getCacheFileFd());
+	}
+	if (!emulated)
+		return (instance.getSyscallsCache().invokeFdopen(fd, mode));
+	return (stdio_open(instance, fd, mode));
 }
 
 int close(int fd) {
 	Libnorsim &instance = Libnorsim::getInstance();
+	uint64_t start = latency_start(instance);
 	std::lock_guard<std::mutex> lg(instance.getGlobalMutex());
+	latency_phase(instance, E_LAT_PHASE_LOCK, start);
 	instance.handleReportRequest();
 	instance.getLogger().log(Loglevel::DEBUG, "handling close(fd=%d)", false, fd);
 	int res;
 
-	if (!instance.isOpened() || (fd != instance.getCacheFileFd()))
+	if (!instance.isOpened() || (fd != instance.getCacheFileFd())) {
 		res = instance.getSyscallsCache().invokeClose(fd);
-	else
+		latency_op(instance, E_LAT_OP_PASSTHROUGH, start);
+	} else {
 		res = internal_close(instance, fd);
+		trace_op(instance, TRACE_OP_CLOSE, 0, 0, res, NULL, 0);
+		latency_op(instance, E_LAT_OP_CLOSE, start);
+	}
 	instance.getLogger().log(Loglevel::DEBUG, "close: return=%d", false, res);
 
 	return (res);
@@ -77,15 +228,22 @@ int close(int fd) {
 
 ssize_t pread(int fd, void *buf, size_t count, off_t offset) {
 	Libnorsim &instance = Libnorsim::getInstance();
+	uint64_t start = latency_start(instance);
+	PaceGuard pg(instance);
 	std::lock_guard<std::mutex> lg(instance.getGlobalMutex());
+	latency_phase(instance, E_LAT_PHASE_LOCK, start);
 	instance.handleReportRequest();
 	instance.getLogger().log(Loglevel::DEBUG, "handling pread(fd=%d, buf=0x%lX, count=0x%lX, offset=0x%lX)", false, fd, buf, count, offset);
 	int res;
 
-	if (fd != instance.getCacheFileFd())
+	if (fd != instance.getCacheFileFd()) {
 		res = instance.getSyscallsCache().invokePread(fd, buf, count, offset);
-	else
+		latency_op(instance, E_LAT_OP_PASSTHROUGH, start);
+	} else {
 		res = internal_pread(instance, fd, buf, count, offset);
+		trace_op(instance, TRACE_OP_PREAD, offset, count, res, buf, (res > 0)?(res):(0));
+		latency_op(instance, E_LAT_OP_PREAD, start);
+	}
 
 	instance.getLogger().log(Loglevel::DEBUG, "pread: return=%d", false, res);
 
@@ -94,15 +252,22 @@ ssize_t pread(int fd, void *buf, size_t count, off_t offset) {
 
 ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset) {
 	Libnorsim &instance = Libnorsim::getInstance();
+	uint64_t start = latency_start(instance);
+	PaceGuard pg(instance);
 	std::lock_guard<std::mutex> lg(instance.getGlobalMutex());
+	latency_phase(instance, E_LAT_PHASE_LOCK, start);
 	instance.handleReportRequest();
 	instance.getLogger().log(Loglevel::DEBUG, "handling pwrite(fd=%d, buf=0x%lX, count=0x%lX, offset=0x%lX)", false, fd, buf, count, offset);
 	int res;
 
-	if (fd != instance.getCacheFileFd())
+	if (fd != instance.getCacheFileFd()) {
 		res = instance.getSyscallsCache().invokePwrite(fd, buf, count, offset);
-	else
+		latency_op(instance, E_LAT_OP_PASSTHROUGH, start);
+	} else {
 		res = internal_pwrite(instance, fd, buf, count, offset);
+		trace_op(instance, TRACE_OP_PWRITE, offset, count, res, buf, count);
+		latency_op(instance, E_LAT_OP_PWRITE, start);
+	}
 
 	instance.getLogger().log(Loglevel::DEBUG, "pwrite: return=%d", false, res);
 
@@ -112,24 +277,43 @@ ssize_t pwrite(int fd, const void *buf, size_t count, off_t offset) {
 ssize_t read(int fd, void *buf, size_t count) {
 	// TODO: simplified version
 	Libnorsim &instance = Libnorsim::getInstance();
+	uint64_t start = latency_start(instance);
 	std::lock_guard<std::mutex> lg(instance.getGlobalMutex());
+	latency_phase(instance, E_LAT_PHASE_LOCK, start);
 	SYSCALL_PROLOGUE("read");
 	instance.getLogger().log(Loglevel::DEBUG, "TODO: stub bypassing to real read function");
-	return (instance.getSyscallsCache().invokeRead(fd, buf, count));
+	if ((fd == instance.getCacheFileFd()) && !instance.isCacheFileReadable()) {
+		errno = EBADF;
+		return (-1);
+	}
+	ssize_t res = instance.getSyscallsCache().invokeRead(fd, buf, count);
+	latency_op(instance, E_LAT_OP_PASSTHROUGH, start);
+	return (res);
 }
 
 ssize_t write(int fd, const void *buf, size_t count) {
 	// TODO: simplified version
 	Libnorsim &instance = Libnorsim::getInstance();
+	uint64_t start = latency_start(instance);
 	std::lock_guard<std::mutex> lg(instance.getGlobalMutex());
+	latency_phase(instance, E_LAT_PHASE_LOCK, start);
 	SYSCALL_PROLOGUE("write");
 	instance.getLogger().log(Loglevel::DEBUG, "TODO: stub bypassing to real write function");
-	return (instance.getSyscallsCache().invokeWrite(fd, buf, count));
+	if ((fd == instance.getCacheFileFd()) && !instance.isCacheFileWritable()) {
+		errno = EBADF;
+		return (-1);
+	}
+	ssize_t res = instance.getSyscallsCache().invokeWrite(fd, buf, count);
+	latency_op(instance, E_LAT_OP_PASSTHROUGH, start);
+	return (res);
 }
 
 int ioctl(int fd, unsigned long request, ...) {
 	Libnorsim &instance = Libnorsim::getInstance();
+	uint64_t start = latency_start(instance);
+	PaceGuard pg(instance);
 	std::lock_guard<std::mutex> lg(instance.getGlobalMutex());
+	latency_phase(instance, E_LAT_PHASE_LOCK, start);
 	instance.handleReportRequest();
 	instance.getLogger().log(Loglevel::DEBUG, "handling ioctl(fd=%d, request=0x%lX)", false, fd, request);
 
@@ -138,10 +322,23 @@ int ioctl(int fd, unsigned long request, ...) {
 	va_list args;
 	va_start(args, request);
 
-	if (fd != instance.getCacheFileFd())
-		res = instance.getSyscallsCache().invokeIoctl(fd, request, args);
-	else
+	if (fd != instance.getCacheFileFd()) {
+		// all requests take (at most) one pointer or integer argument
+		res = instance.getSyscallsCache().invokeIoctl(fd, request, va_arg(args, void*));
+		latency_op(instance, E_LAT_OP_PASSTHROUGH, start);
+	} else {
+		va_list trace_args;
+		va_copy(trace_args, args);
 		res = internal_ioctl(instance, fd, request, args);
+		trace_ioctl(instance, request, trace_args, res);
+		va_end(trace_args);
+		switch (request) {
+			case MEMGETINFO: latency_op(instance, E_LAT_OP_GETINFO, start); break;
+			case MEMUNLOCK: latency_op(instance, E_LAT_OP_UNLOCK, start); break;
+			case MEMERASE: latency_op(instance, E_LAT_OP_ERASE, start); break;
+			case NORSIM_IOC_BATCH: latency_op(instance, E_LAT_OP_BATCH, start); break;
+		}
+	}
 
 	instance.getLogger().log(Loglevel::DEBUG, "ioctl: return=%d", false, res);
 
@@ -149,11 +346,453 @@ int ioctl(int fd, unsigned long request, ...) {
 	return (res);
 }
 
+ssize_t sendfile(int out_fd, int in_fd, off_t *offset, size_t count) {
+	loff_t off = (NULL != offset)?(*offset):(0);
+	ssize_t res = bulk_common(in_fd, (NULL != offset)?(&off):(NULL), out_fd, NULL, count, 0, bulk_sendfile);
+	if ((NULL != offset) && (res >= 0))
+		*offset = off;
+	return (res);
+}
+
+ssize_t sendfile64(int out_fd, int in_fd, off64_t *offset, size_t count) {
+	loff_t off = (NULL != offset)?(*offset):(0);
+	ssize_t res = bulk_common(in_fd, (NULL != offset)?(&off):(NULL), out_fd, NULL, count, 0, bulk_sendfile);
+	if ((NULL != offset) && (res >= 0))
+		*offset = off;
+	return (res);
+}
+
+ssize_t splice(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned flags) {
+	return (bulk_common(fd_in, off_in, fd_out, off_out, len, flags, bulk_splice));
+}
+
+ssize_t copy_file_range(int fd_in, loff_t *off_in, int fd_out, loff_t *off_out, size_t len, unsigned flags) {
+	return (bulk_common(fd_in, off_in, fd_out, off_out, len, flags, bulk_copy_file_range));
+}
+
+int fsync(int fd) {
+	return (sync_common(fd, "fsync", Libnorsim::getInstance().getSyscallsCache().getSyscalls().fsyncSC));
+}
+
+int fdatasync(int fd) {
+	return (sync_common(fd, "fdatasync", Libnorsim::getInstance().getSyscallsCache().getSyscalls().fdatasyncSC));
+}
+
+int syncfs(int fd) {
+	return (sync_common(fd, "syncfs", Libnorsim::getInstance().getSyscallsCache().getSyscalls().syncfsSC));
+}
+
+// Cache file is recognized by device and inode of descriptor opened by libc,
+// other files are passed through without global mutex or path resolution.
+// Truncating opens are checked before opening, cache file is never truncated.
+static int open_common(int dirfd, const char *path, int oflag, mode_t mode) {
+	if (Libnorsim::isConstructing())
+		return (get_next<decltype(&openat)>("openat")(dirfd, path, oflag, mode));
+
+	Libnorsim &instance = Libnorsim::getInstance();
+	uint64_t start = latency_start(instance);
+	struct stat st;
+
+	if ((oflag & O_TRUNC) && (0 == fstatat(dirfd, path, &st, 0)) && instance.isCacheFile(st))
+		return (open_cache_file(instance, path, oflag, start));
+
+	// called directly, SyscallsCache::invoke() keeps errno in shared state
+	int res = instance.getSyscallsCache().getSyscalls().openatSC(dirfd, path, oflag, mode);
+	if ((res >= 0) && (0 == fstat(res, &st)) && instance.isCacheFile(st)) {
+		int saved_errno = errno;
+		instance.getSyscallsCache().invokeClose(res);
+		errno = saved_errno;
+		return (open_cache_file(instance, path, oflag, start));
+	}
+	if (NULL != instance.getLatencyStats()) {
+		std::lock_guard<std::mutex> lg(instance.getGlobalMutex());
+		latency_op(instance, E_LAT_OP_PASSTHROUGH, start);
+	}
+	return (res);
+}
+
+static int open_cache_file(Libnorsim &libnorsim, const char *path, int oflag, uint64_t start) {
+	std::lock_guard<std::mutex> lg(libnorsim.getGlobalMutex());
+	latency_phase(libnorsim, E_LAT_PHASE_LOCK, start);
+	libnorsim.handleReportRequest();
+	libnorsim.getLogger().log(Loglevel::DEBUG, "handling open(path=%s, oflag=0x%X)", false, path, oflag);
+
+	// device is always opened for reading and writing (descriptor is used by storage),
+	// access mode of caller is checked by emulated operations
+	int res = internal_open(libnorsim, libnorsim.getCacheFile(), (oflag & ~(O_ACCMODE | O_CREAT | O_EXCL | O_TRUNC | O_APPEND)) | O_RDWR, 0);
+	if (res >= 0)
+		libnorsim.setCacheFileAccess(oflag & O_ACCMODE);
+	trace_op(libnorsim, TRACE_OP_OPEN, 0, 0, res, NULL, 0);
+	latency_op(libnorsim, E_LAT_OP_OPEN, start);
+
+	libnorsim.getLogger().log(Loglevel::DEBUG, "open: return=%d", false, res);
+	return (res);
+}
+
+static FILE* fopen_common(const char *path, const char *mode) {
+	if (Libnorsim::isConstructing())
+		return (get_next<decltype(&fopen)>("fopen")(path, mode));
+
+	Libnorsim &instance = Libnorsim::getInstance();
+	int oflag = (NULL != strchr(mode, '+'))?(O_RDWR):(('r' == mode[0])?(O_RDONLY):(O_WRONLY));
+	struct stat st;
+	FILE *file;
+
+	if ('w' == mode[0]) {
+		if ((0 != stat(path, &st)) || !instance.isCacheFile(st))
+			return (instance.getSyscallsCache().getSyscalls().fopenSC(path, mode));
+	} else {
+		file = instance.getSyscallsCache().getSyscalls().fopenSC(path, mode);
+		if ((NULL == file) || (0 != fstat(fileno(file), &st)) || !instance.isCacheFile(st))
+			return (file);
+		fclose(file);
+	}
+
+	int fd = open_cache_file(instance, path, oflag, latency_start(instance));
+	if (fd < 0)
+		return (NULL);
+	return (stdio_open(instance, fd, mode));
+}
+
+// stream transfers are split on eraseblock boundaries and use emulated pread/pwrite
+static FILE* stdio_open(Libnorsim &libnorsim, int fd, const char *mode) {
+	cookie_io_functions_t funcs = {stdio_read, stdio_write, stdio_seek, stdio_close};
+	// appending streams start at the end of device, like on MTD character device
+	st_stdio_cookie_t *cookie = new st_stdio_cookie_t{fd, ('a' == mode[0])?(static_cast<off64_t>(libnorsim.getSize())):(0)};
+
+	FILE *file = fopencookie(cookie, mode, funcs);
+	if (NULL == file) {
+		libnorsim.getLogger().log(Loglevel::ERROR, "Couldn't create stream for cache file");
+		delete cookie;
+	}
+	return (file);
+}
+
+static ssize_t stdio_read(void *cookie, char *buf, size_t size) {
+	st_stdio_cookie_t *stream = static_cast<st_stdio_cookie_t*>(cookie);
+	Libnorsim &instance = Libnorsim::getInstance();
+	uint64_t start = latency_start(instance);
+	PaceGuard pg(instance);
+	std::lock_guard<std::mutex> lg(instance.getGlobalMutex());
+	latency_phase(instance, E_LAT_PHASE_LOCK, start);
+	instance.handleReportRequest();
+
+	size_t done = 0;
+	while ((done < size) && (static_cast<unsigned long>(stream->position) < instance.getSize())) {
+		size_t count = instance.getGeometry().getBlockOffset(instance.getGeometry().getBlock(stream->position) + 1) - stream->position;
+		if (count > size - done)
+			count = size - done;
+		int res = internal_pread(instance, stream->fd, &buf[done], count, stream->position);
+		trace_op(instance, TRACE_OP_PREAD, stream->position, count, res, &buf[done], (res > 0)?(res):(0));
+		if (res <= 0) {
+			if (0 == done) {
+				errno = EIO;
+				return (-1);
+			}
+			break;
+		}
+		stream->position += res;
+		done += res;
+	}
+	latency_op(instance, E_LAT_OP_PREAD, start);
+	return (done);
+}
+
+static ssize_t stdio_write(void *cookie, const char *buf, size_t size) {
+	st_stdio_cookie_t *stream = static_cast<st_stdio_cookie_t*>(cookie);
+	Libnorsim &instance = Libnorsim::getInstance();
+	uint64_t start = latency_start(instance);
+	PaceGuard pg(instance);
+	std::lock_guard<std::mutex> lg(instance.getGlobalMutex());
+	latency_phase(instance, E_LAT_PHASE_LOCK, start);
+	instance.handleReportRequest();
+
+	size_t done = 0;
+	while (done < size) {
+		if (static_cast<unsigned long>(stream->position) >= instance.getSize()) {
+			errno = ENOSPC;
+			break;
+		}
+		size_t count = instance.getGeometry().getBlockOffset(instance.getGeometry().getBlock(stream->position) + 1) - stream->position;
+		if (count > size - done)
+			count = size - done;
+		int res = internal_pwrite(instance, stream->fd, &buf[done], count, stream->position);
+		trace_op(instance, TRACE_OP_PWRITE, stream->position, count, res, &buf[done], count);
+		if (res <= 0) {
+			errno = EIO;
+			break;
+		}
+		stream->position += res;
+		done += res;
+	}
+	latency_op(instance, E_LAT_OP_PWRITE, start);
+	return ((0 == done)?(-1):(done));
+}
+
+static int stdio_seek(void *cookie, off64_t *offset, int whence) {
+	st_stdio_cookie_t *stream = static_cast<st_stdio_cookie_t*>(cookie);
+	Libnorsim &instance = Libnorsim::getInstance();
+	off64_t position;
+
+	switch (whence) {
+		case SEEK_SET: position = *offset; break;
+		case SEEK_CUR: position = stream->position + *offset; break;
+		case SEEK_END: position = instance.getSize() + *offset; break;
+		default: errno = EINVAL; return (-1);
+	}
+	if ((position < 0) || (static_cast<unsigned long>(position) > instance.getSize())) {
+		errno = EINVAL;
+		return (-1);
+	}
+	stream->position = position;
+	*offset = position;
+	return (0);
+}
+
+static int stdio_close(void *cookie) {
+	st_stdio_cookie_t *stream = static_cast<st_stdio_cookie_t*>(cookie);
+	Libnorsim &instance = Libnorsim::getInstance();
+	uint64_t start = latency_start(instance);
+	std::lock_guard<std::mutex> lg(instance.getGlobalMutex());
+	latency_phase(instance, E_LAT_PHASE_LOCK, start);
+	instance.handleReportRequest();
+
+	int res = internal_close(instance, stream->fd);
+	trace_op(instance, TRACE_OP_CLOSE, 0, 0, res, NULL, 0);
+	latency_op(instance, E_LAT_OP_CLOSE, start);
+	delete stream;
+	return (res);
+}
+
+// Sync of cache file is handled by sync policy (block cache is written back without one),
+// syncfs() still reaches other files on same filesystem unless policy is "none".
+static int sync_common(int fd, const char *name, int (*real)(int fd)) {
+	Libnorsim &instance = Libnorsim::getInstance();
+	uint64_t start = latency_start(instance);
+	std::unique_lock<std::mutex> lock(instance.getGlobalMutex());
+	latency_phase(instance, E_LAT_PHASE_LOCK, start);
+	SYSCALL_PROLOGUE(name);
+	int res;
+
+	// other files are flushed without global mutex, emulated I/O doesn't wait for their disks
+	if (!instance.isOpened() || (fd != instance.getCacheFileFd())) {
+		lock.unlock();
+		res = real(fd);
+		if (NULL != instance.getLatencyStats()) {
+			lock.lock();
+			latency_op(instance, E_LAT_OP_PASSTHROUGH, start);
+		}
+		return (res);
+	}
+
+	if (NULL != instance.getEraseEngine())
+		instance.getEraseEngine()->drain();
+	SyncPolicy *sync = instance.getSyncPolicy();
+	if (NULL != sync) {
+		res = sync->requestSync();
+		if ((0 == res) && (E_SYNC_NONE != sync->getMode()) && (real == instance.getSyscallsCache().getSyscalls().syncfsSC))
+			res = real(fd);
+	} else if ((NULL != instance.getBlockCache()) && !instance.getBlockCache()->flush()) {
+		res = -1;
+	} else {
+		res = real(fd);
+	}
+	if (res < 0)
+		errno = EIO;
+	latency_op(instance, E_LAT_OP_SYNC, start);
+	instance.getLogger().log(Loglevel::DEBUG, "%s: return=%d", false, name, res);
+	return (res);
+}
+
+// Transfers not touching cache file are passed to real call unchanged (with their own offset semantics).
+static ssize_t bulk_common(int in_fd, loff_t *in_off, int out_fd, loff_t *out_off, size_t len, unsigned flags, bulk_copy_t copy) {
+	Libnorsim &instance = Libnorsim::getInstance();
+	uint64_t start = latency_start(instance);
+	PaceGuard pg(instance);
+	std::lock_guard<std::mutex> lg(instance.getGlobalMutex());
+	latency_phase(instance, E_LAT_PHASE_LOCK, start);
+	instance.handleReportRequest();
+	instance.getLogger().log(Loglevel::DEBUG, "handling bulk transfer(in_fd=%d, out_fd=%d, len=0x%lX)", false, in_fd, out_fd, len);
+	ssize_t res;
+
+	if (!instance.isOpened() || ((in_fd != instance.getCacheFileFd()) && (out_fd != instance.getCacheFileFd()))) {
+		if (bulk_sendfile == copy) {
+			off64_t off = (NULL != in_off)?(*in_off):(0);
+			res = instance.getSyscallsCache().invokeSendfile64(out_fd, in_fd, (NULL != in_off)?(&off):(NULL), len);
+			if (NULL != in_off)
+				*in_off = off;
+		} else if (bulk_splice == copy) {
+			res = instance.getSyscallsCache().invokeSplice(in_fd, in_off, out_fd, out_off, len, flags);
+		} else {
+			res = instance.getSyscallsCache().invokeCopyFileRange(in_fd, in_off, out_fd, out_off, len, flags);
+		}
+		latency_op(instance, E_LAT_OP_PASSTHROUGH, start);
+	} else {
+		res = bulk_transfer(instance, in_fd, in_off, out_fd, out_off, len, flags, copy);
+		latency_op(instance, E_LAT_OP_BULK, start);
+	}
+
+	instance.getLogger().log(Loglevel::DEBUG, "bulk transfer: return=%ld", false, res);
+	return (res);
+}
+
+// Transfer is split on eraseblock boundaries of cache file. Reads of blocks which can't fault are
+// done by real zero-copy call on cache file descriptor (block cache is flushed first) and only
+// bump read counter of block. Grave blocks are read with emulated pread and writes to cache file
+// always go through emulated pwrite, both with bounce buffer. File position of descriptors is
+// used and updated when offset pointer is not given, like real calls do.
+static ssize_t bulk_transfer(Libnorsim &libnorsim, int in_fd, loff_t *in_off, int out_fd, loff_t *out_off, size_t len, unsigned flags, bulk_copy_t copy) {
+	SyscallsCache &sc = libnorsim.getSyscallsCache();
+	NorDevice &device = libnorsim.getDevice();
+	const unsigned long erase_size = libnorsim.getEraseSize();
+	NorGeometry &geometry = libnorsim.getGeometry();
+	const bool from_cache = (in_fd == libnorsim.getCacheFileFd());
+	const bool to_cache = (out_fd == libnorsim.getCacheFileFd());
+	const bool in_positioned = (NULL != in_off) || from_cache;
+	const bool out_positioned = (NULL != out_off) || to_cache;
+	loff_t in_pos = (NULL != in_off)?(*in_off):((from_cache)?(lseek(in_fd, 0, SEEK_CUR)):(0));
+	loff_t out_pos = (NULL != out_off)?(*out_off):((to_cache)?(lseek(out_fd, 0, SEEK_CUR)):(0));
+	aligned_buffer_t bounce;
+
+	if ((in_pos < 0) || (out_pos < 0)) {
+		errno = EINVAL;
+		return (-1);
+	}
+	// reads from cache file are partially done by real call on descriptor opened for writing too
+	if ((from_cache && !libnorsim.isCacheFileReadable()) || (to_cache && !libnorsim.isCacheFileWritable())) {
+		errno = EBADF;
+		return (-1);
+	}
+	if (from_cache && !to_cache && (NULL != libnorsim.getBlockCache()) && !libnorsim.getBlockCache()->flush()) {
+		errno = EIO;
+		return (-1);
+	}
+
+	size_t done = 0;
+	while (done < len) {
+		loff_t cache_pos = (from_cache)?(in_pos):(out_pos);
+		if (static_cast<unsigned long>(cache_pos) >= libnorsim.getSize()) {
+			if (!from_cache)
+				errno = ENOSPC;
+			break;
+		}
+		unsigned index = geometry.getBlock(cache_pos);
+		size_t count = geometry.getBlockOffset(index + 1) - cache_pos;
+		// copy within cache file can't cross eraseblock of output either
+		if (from_cache && to_cache) {
+			if (static_cast<unsigned long>(out_pos) >= libnorsim.getSize()) {
+				errno = ENOSPC;
+				break;
+			}
+			size_t out_count = geometry.getBlockOffset(geometry.getBlock(out_pos) + 1) - out_pos;
+			if (count > out_count)
+				count = out_count;
+		}
+		if (count > len - done)
+			count = len - done;
+		ssize_t res;
+
+		if (from_cache && !to_cache && device.isPowered() && !device.hasBitErrors() && (E_PAGE_GRAVE != device.getPage(index).type)) {
+			loff_t off = in_pos;
+			loff_t out = out_pos;
+			if (!block_access(libnorsim, index)) {
+				if (0 == done)
+					return (-1);
+				break;
+			}
+			BlockLock bl(libnorsim, index, 1);
+			device.noteRead(index, in_pos, count);
+			{
+				PhaseTimer pt(libnorsim.getLatencyStats(), E_LAT_PHASE_IO);
+				res = copy(libnorsim, in_fd, &off, out_fd, (NULL != out_off)?(&out):(NULL), count, flags);
+			}
+			if ((res > 0) && (NULL != libnorsim.getTimingModel()))
+				libnorsim.getTimingModel()->chargeRead(libnorsim.getTimingModel()->getReadCost(res));
+			trace_op(libnorsim, TRACE_OP_PREAD, in_pos, count, res, NULL, 0);
+		} else {
+			if (!bounce) {
+				bounce.reset(allocAligned(erase_size));
+				if (!bounce) {
+					errno = ENOMEM;
+					if (0 == done)
+						return (-1);
+					break;
+				}
+			}
+			if (from_cache) {
+				res = internal_pread(libnorsim, in_fd, bounce.get(), count, in_pos);
+				trace_op(libnorsim, TRACE_OP_PREAD, in_pos, count, res, bounce.get(), (res > 0)?(res):(0));
+				if (res < 0)
+					errno = EIO;
+			} else if (in_positioned) {
+				res = sc.invokePread(in_fd, bounce.get(), count, in_pos);
+			} else {
+				res = sc.invokeRead(in_fd, bounce.get(), count);
+			}
+			if (res > 0) {
+				ssize_t written;
+				if (to_cache) {
+					written = internal_pwrite(libnorsim, out_fd, bounce.get(), res, out_pos);
+					trace_op(libnorsim, TRACE_OP_PWRITE, out_pos, res, written, bounce.get(), res);
+					if (written < 0)
+						errno = EIO;
+				} else if (out_positioned) {
+					written = sc.invokePwrite(out_fd, bounce.get(), res, out_pos);
+				} else {
+					written = sc.invokeWrite(out_fd, bounce.get(), res);
+				}
+				// data consumed from unpositioned input can't be returned, report what was read
+				if ((written < res) && in_positioned)
+					res = (written > 0)?(written):(-1);
+			}
+		}
+
+		if (res <= 0) {
+			if ((0 == done) && (res < 0))
+				return (-1);
+			break;
+		}
+		in_pos += res;
+		out_pos += res;
+		done += res;
+		if (static_cast<size_t>(res) < count)
+			break;
+	}
+
+	if (NULL != in_off)
+		*in_off = in_pos;
+	else if (from_cache)
+		lseek(in_fd, in_pos, SEEK_SET);
+	if (NULL != out_off)
+		*out_off = out_pos;
+	else if (to_cache)
+		lseek(out_fd, out_pos, SEEK_SET);
+	return (done);
+}
+
+static ssize_t bulk_sendfile(Libnorsim &libnorsim, int in_fd, loff_t *in_off, int out_fd, loff_t *out_off, size_t len, unsigned flags) {
+	(void)out_off;
+	(void)flags;
+	off64_t off = *in_off;
+	ssize_t res = libnorsim.getSyscallsCache().invokeSendfile64(out_fd, in_fd, &off, len);
+	*in_off = off;
+	return (res);
+}
+
+static ssize_t bulk_splice(Libnorsim &libnorsim, int in_fd, loff_t *in_off, int out_fd, loff_t *out_off, size_t len, unsigned flags) {
+	return (libnorsim.getSyscallsCache().invokeSplice(in_fd, in_off, out_fd, out_off, len, flags));
+}
+
+static ssize_t bulk_copy_file_range(Libnorsim &libnorsim, int in_fd, loff_t *in_off, int out_fd, loff_t *out_off, size_t len, unsigned flags) {
+	return (libnorsim.getSyscallsCache().invokeCopyFileRange(in_fd, in_off, out_fd, out_off, len, flags));
+}
+
 void sig_handler(int signum)
 {
 	switch (signum) {
 		case SIGUSR1: report_requested = SIGNAL_REPORT_SHORT; break;
 		case SIGUSR2: report_requested = SIGNAL_REPORT_DETAILED; break;
+		case SIGHUP: reload_requested = 1; break;
 	}
 }
 
@@ -168,13 +807,27 @@ static int internal_open(Libnorsim &libnorsim, const char *path, int oflag, mode
 			goto err;
 		}
 		libnorsim.setCacheFileFd(ret);
-		if (flock(libnorsim.getCacheFileFd(), LOCK_EX) < 0) {
+		// processes sharing device exclude only ones which don't
+		if (flock(libnorsim.getBackingFd(), (libnorsim.getSharedDevice())?(LOCK_SH):(LOCK_EX)) < 0) {
 			libnorsim.getLogger().log(Loglevel::FATAL, "Error while acquiring lock on cache file: %s, errno=%d",
 				false, path, libnorsim.getSyscallsCache().getSyscalls().getLastErrno());
 			goto err;
 		}
+		if (libnorsim.isDirectIo()) {
+			int backing_fd = libnorsim.getSyscallsCache().invokeOpen(libnorsim.getCacheFile(), O_RDWR | O_DIRECT | O_CLOEXEC, 0);
+			if (backing_fd < 0) {
+				libnorsim.getLogger().log(Loglevel::FATAL, "Couldn't open cache file for direct I/O: %s, errno=%d",
+					false, path, libnorsim.getSyscallsCache().getSyscalls().getLastErrno());
+				goto err;
+			}
+			libnorsim.setBackingFd(backing_fd);
+		}
 		libnorsim.setOpened();
 		libnorsim.getLogger().log(Loglevel::INFO, "Opened cache file: %s", false, path);
+		libnorsim.applyAging();
+		// reopening device after power cut is power cycle
+		if (!libnorsim.getDevice().isPowered())
+			libnorsim.getDevice().restorePower();
 	} else {
 		libnorsim.getLogger().log(Loglevel::ERROR, "Couldn't re-open cache file which is in use");
 		goto err;
@@ -190,6 +843,16 @@ static int internal_close(Libnorsim &libnorsim, int fd) {
 	int ret;
 
 	if (libnorsim.isOpened()) {
+		if (libnorsim.getEraseEngine())
+			libnorsim.getEraseEngine()->drain();
+		if (libnorsim.getSyncPolicy())
+			libnorsim.getSyncPolicy()->noteClose();
+		if (libnorsim.getBlockCache() && !libnorsim.getBlockCache()->flush())
+			libnorsim.getLogger().log(Loglevel::ERROR, "Couldn't flush block cache to cache file: %s", false, libnorsim.getCacheFile());
+		if (libnorsim.isDirectIo()) {
+			libnorsim.getSyscallsCache().invokeClose(libnorsim.getBackingFd());
+			libnorsim.setBackingFd(-1);
+		}
 		ret = libnorsim.getSyscallsCache().invokeClose(fd);
 		if (ret < 0) {
 			libnorsim.getLogger().log(Loglevel::FATAL, "Error while closing cache file: %s, errno=%d",
@@ -211,72 +874,47 @@ err:
 }
 
 static int internal_pread(Libnorsim &libnorsim, int fd, void *buf, size_t count, off_t offset) {
-	int ret = 0;
-	unsigned index = offset / libnorsim.getEraseSize();
-	unsigned index_in = offset - index * libnorsim.getEraseSize();
+	(void)fd;
+	NorDevice &device = libnorsim.getDevice();
+	unsigned index = device.getBlock(offset);
 
-	if ((index_in + count) > libnorsim.getEraseSize()) {
-		libnorsim.getLogger().log(Loglevel::WARNING, "Read block exceeds eraseblock boundary");
+	if (!libnorsim.isCacheFileReadable()) {
+		errno = EBADF;
 		return (-1);
 	}
 
-	PageManager &pm = libnorsim.getPageManager();
-	pm.getPage(index).reads++;
-	if (E_PAGE_GRAVE == pm.getPage(index).type) {
-		if (pm.getPage(index).reads <= pm.getPage(index).limit) {
-			return (libnorsim.getSyscallsCache().invokePread(fd, buf, count, offset));
-		} else {
-			if (E_BEH_EIO == libnorsim.getPageManager().getGravePageBehavior()) {
-				libnorsim.getLogger().log(Loglevel::NOTE, "EIO error at page: %lu", false, index);
-				return (-1);
-			} else {
-				ret = libnorsim.getSyscallsCache().invokePread(fd, buf, count, offset);
-				unsigned long rnd = rand() % count;
-				char rnd_byte = ((char*)buf)[rnd] ^ rnd;
-				libnorsim.getLogger().log(Loglevel::NOTE, "RND error at page: %lu[%lu], expected: 0x%02X, is 0x%02X", false, index, index_in + rnd, ((char*)buf)[rnd], rnd_byte);
-				((char*)buf)[rnd] = rnd_byte;
-			}
-		}
-	} else {
-		return (libnorsim.getSyscallsCache().invokePread(fd, buf, count, offset));
-	}
-
+	// rejected by device
+	if (!device.isInBlock(offset, count))
+		return (device.read(buf, count, offset));
+	if (!block_access(libnorsim, index))
+		return (-1);
+	BlockLock bl(libnorsim, index, 1);
+	int ret = device.read(buf, count, offset);
+	if ((ret > 0) && (NULL != libnorsim.getTimingModel()))
+		libnorsim.getTimingModel()->chargeRead(libnorsim.getTimingModel()->getReadCost(ret));
 	return (ret);
 }
 
 static int internal_pwrite(Libnorsim &libnorsim, int fd, const void *buf, size_t count, off_t offset) {
-	int ret = 0;
-	unsigned index = offset / libnorsim.getEraseSize();
-	unsigned index_in = offset - index * libnorsim.getEraseSize();
-	
-	if ((index_in + count) > libnorsim.getEraseSize()) {
-		libnorsim.getLogger().log(Loglevel::WARNING, "Write block exceeds eraseblock boundary");
+	(void)fd;
+	NorDevice &device = libnorsim.getDevice();
+	unsigned index = device.getBlock(offset);
+	int ret;
+
+	if (!libnorsim.isCacheFileWritable()) {
+		errno = EBADF;
 		return (-1);
 	}
-	if (count != libnorsim.getSyscallsCache().invokePread(fd, &libnorsim.getPageBuffer()[index_in], count, offset)) {
-		libnorsim.getLogger().log(Loglevel::WARNING, "Pre-read failed");
+	if (!device.isInBlock(offset, count))
+		return (device.program(buf, count, offset));
+	if (!block_access(libnorsim, index))
 		return (-1);
-	}
-
-	PageManager &pm = libnorsim.getPageManager();
-	pm.mergeBitMasks(index_in, count, libnorsim.getPageBuffer(), static_cast<const char*>(buf));
-	pm.getPage(index).writes++;
-	if (count == libnorsim.getSyscallsCache().invokePwrite(fd, &libnorsim.getPageBuffer()[index_in], count, offset))
-		ret = count;
-	else
-		ret = -1;
-	if (E_PAGE_WEAK == pm.getPage(index).type) {
-		if (pm.getPage(index).erases <= pm.getPage(index).limit) {
-			return (ret);
-		} else {
-			if (E_BEH_EIO == libnorsim.getPageManager().getWeakPageBehavior()) {
-				libnorsim.getLogger().log(Loglevel::NOTE, "EIO error at page: %lu", false, index);
-				return (-1);
-			} else {
-				libnorsim.getLogger().log(Loglevel::NOTE, "RND error at page: %lu", false, index);
-			}
-		}
-	}
+	BlockLock bl(libnorsim, index, 1);
+	ret = device.program(buf, count, offset);
+	if (NULL != libnorsim.getSyncPolicy())
+		libnorsim.getSyncPolicy()->noteWrite(offset, count);
+	if ((ret > 0) && (NULL != libnorsim.getTimingModel()))
+		libnorsim.getTimingModel()->chargeProgram(libnorsim.getTimingModel()->getProgramCost(offset, count, device.getPage(index)));
 	return (ret);
 }
 
@@ -287,89 +925,358 @@ static int internal_ioctl_memgetinfo(Libnorsim &libnorsim, va_list args) {
 	return (0);
 }
 
-static int internal_ioctl_memunlock(Libnorsim &libnorsim, va_list args) {
-	erase_info_t *ei = va_arg(args, erase_info_t*);
-	unsigned index = (ei->start) / libnorsim.getEraseSize();
-	libnorsim.getLogger().log(Loglevel::NOTE, "Got MEMUNLOCK request at page: %d, start=0x%lX, length=0x%lX", false, index, ei->start, ei->length);
+// uniform device has no erase regions, like MTD reports it
+static int internal_ioctl_memgetregioncount(Libnorsim &libnorsim, va_list args) {
+	int *count = va_arg(args, int*);
+	libnorsim.getLogger().log(Loglevel::NOTE, "Got MEMGETREGIONCOUNT request");
+	*count = libnorsim.getGeometry().getRegions().size();
+	return (0);
+}
+
+static int internal_ioctl_memgetregioninfo(Libnorsim &libnorsim, va_list args) {
+	region_info_t *ri = va_arg(args, region_info_t*);
+	const std::vector<st_erase_region_t> &regions = libnorsim.getGeometry().getRegions();
+	libnorsim.getLogger().log(Loglevel::NOTE, "Got MEMGETREGIONINFO request, region=%u", false, ri->regionindex);
+
+	if (ri->regionindex >= regions.size()) {
+		errno = EINVAL;
+		return (-1);
+	}
+	const st_erase_region_t &region = regions[ri->regionindex];
+	ri->offset = region.offset;
+	ri->erasesize = region.eraseSize;
+	ri->numblocks = region.blocks;
+	return (0);
+}
 
-	if ((0 != (ei->start % libnorsim.getEraseSize())) ||
-		(0 != (ei->length % libnorsim.getEraseSize())) ||
-		((ei->length / libnorsim.getEraseSize()) > 1)) {
-		libnorsim.getLogger().log(Loglevel::WARNING, "Invalid erase_info_t, start=0x%lX, length=0x%lX",
-			false, (unsigned long)ei->start, (unsigned long)ei->length);
+static int internal_ioctl_getclock(Libnorsim &libnorsim, va_list args) {
+	struct norsim_clock *clock = va_arg(args, struct norsim_clock*);
+	if (NULL == libnorsim.getTimingModel()) {
+		errno = ENOTTY;
 		return (-1);
 	}
-	libnorsim.getPageManager().getPage(index).unlocked = true;
-	
+	memcpy(clock, &libnorsim.getTimingModel()->getClock(), sizeof(struct norsim_clock));
 	return (0);
 }
 
-static int internal_ioctl_memerase(Libnorsim &libnorsim, va_list args) {
-	int ret = 0;
-	erase_info_t *ei = va_arg(args, erase_info_t*);
-	unsigned index = (ei->start) / libnorsim.getEraseSize();
-	libnorsim.getLogger().log(Loglevel::NOTE, "Got MEMERASE request at page: %d, start=0x%lX, length=0x%lX", false, index, ei->start, ei->length);
+static int internal_ioctl_memunlock(Libnorsim &libnorsim, const erase_info_t *ei) {
+	NorDevice &device = libnorsim.getDevice();
+	unsigned first = device.getBlock(ei->start);
+	unsigned count = device.getBlocksIn(ei->start, ei->length);
+	libnorsim.getLogger().log(Loglevel::NOTE, "Got MEMUNLOCK request at page: %d, start=0x%lX, length=0x%lX", false, first, ei->start, ei->length);
+	PROBE2(unlock, first, count);
+
+	if (!libnorsim.isCacheFileWritable()) {
+		errno = EPERM;
+		return (-1);
+	}
+	if (!is_erase_info_valid(libnorsim, ei)) {
+		errno = EINVAL;
+		return (-1);
+	}
+	for (unsigned index = first; index < first + count; ++index) {
+		if (!block_access(libnorsim, index))
+			return (-1);
+	}
+	BlockLock bl(libnorsim, first, count);
+	return (device.unlockBlocks(first, count));
+}
+
+static int internal_ioctl_memerase(Libnorsim &libnorsim, const erase_info_t *ei) {
+	NorDevice &device = libnorsim.getDevice();
+	unsigned first = device.getBlock(ei->start);
+	unsigned count = device.getBlocksIn(ei->start, ei->length);
+	libnorsim.getLogger().log(Loglevel::NOTE, "Got MEMERASE request at page: %d, start=0x%lX, length=0x%lX", false, first, ei->start, ei->length);
+	PROBE2(erase, first, count);
 
-	if ((0 != (ei->start % libnorsim.getEraseSize())) ||
-		(0 != (ei->length % libnorsim.getEraseSize())) ||
-		((ei->length / libnorsim.getEraseSize()) > 1)) {
-		libnorsim.getLogger().log(Loglevel::WARNING, "Invalid erase_info_t, start=0x%lX, length=0x%lX",
-			false, (unsigned long)ei->start, (unsigned long)ei->length);
+	if (!libnorsim.isCacheFileWritable()) {
+		errno = EPERM;
 		return (-1);
 	}
+	if (!is_erase_info_valid(libnorsim, ei)) {
+		errno = EINVAL;
+		return (-1);
+	}
+	for (unsigned index = first; index < first + count; ++index) {
+		if (!block_access(libnorsim, index))
+			return (-1);
+	}
 
-	memset(libnorsim.getPageBuffer(), 0xFF, libnorsim.getEraseSize());
-	PageManager &pm = libnorsim.getPageManager();
-	if (pm.getPage(index).unlocked) {
-		pm.getPage(index).erases++;
-		pm.getPage(index).unlocked = false;
-		if (pm.getPage(index).erases <= pm.getPage(index).limit) {
-			if (libnorsim.getEraseSize() ==
-				libnorsim.getSyscallsCache().invokePwrite(libnorsim.getCacheFileFd(), libnorsim.getPageBuffer(), ei->length, ei->start)
-			)
-				ret = 0;
-			else
-				ret = -1;
-			return (ret);
-		}
-		if (E_PAGE_WEAK == pm.getPage(index).type) {
-			pm.setBitMask(index, libnorsim.getPageBuffer());
-			if (libnorsim.getEraseSize() ==
-				libnorsim.getSyscallsCache().invokePwrite(libnorsim.getCacheFileFd(), libnorsim.getPageBuffer(), ei->length, ei->start)
-			)
-				ret = 0;
-			else
+	// lock state is checked and cleared by erase atomically for other processes
+	BlockLock bl(libnorsim, first, count);
+	if (!device.isUnlocked(first, count)) {
+		errno = EPERM;
+		return (-1);
+	}
+
+	// without power erase fails right away
+	EraseEngine *engine = libnorsim.getEraseEngine();
+	if ((NULL == engine) || !device.isPowered())
+		return (erase_blocks(libnorsim, first, count));
+	TimingModel *timing = libnorsim.getTimingModel();
+	std::chrono::nanoseconds duration = engine->getEraseTime(count);
+	if (NULL != timing) {
+		uint64_t cost = 0;
+		for (unsigned index = first; index < first + count; ++index)
+			cost += timing->getEraseCost(device.getPage(index));
+		duration = std::chrono::nanoseconds(timing->getRealTime(cost));
+	}
+	engine->queue(first, count, erase_job, duration);
+	return (0);
+}
+
+// Operations are executed like separate requests, including tracing (queued
+// erase is traced by erase_job()), but report request, logging of request and
+// global mutex are handled once. Without NS_BLOCK_CACHE touched blocks are
+// kept in temporary block cache, so they are written back together at the end.
+static int internal_ioctl_batch(Libnorsim &libnorsim, int fd, va_list args) {
+	struct norsim_batch *batch = va_arg(args, struct norsim_batch*);
+	struct norsim_op *ops = reinterpret_cast<struct norsim_op*>(static_cast<uintptr_t>(batch->ops));
+	libnorsim.getLogger().log(Loglevel::NOTE, "Got NORSIM_IOC_BATCH request: %u operations", false, batch->count);
+
+	batch->done = 0;
+	batch->failed = 0;
+	if ((NULL == ops) && (0 != batch->count)) {
+		errno = EINVAL;
+		return (-1);
+	}
+	for (unsigned i = 0; i < batch->count; ++i)
+		ops[i].result = 0;
+
+	libnorsim.beginBatch();
+	for (unsigned i = 0; i < batch->count; ++i) {
+		batch->done++;
+		if (batch_op(libnorsim, fd, ops[i]) >= 0)
+			continue;
+		batch->failed++;
+		if (batch->flags & NORSIM_BATCH_STOP_ON_ERROR)
+			break;
+	}
+	if (!libnorsim.endBatch() || (0 != batch->failed)) {
+		errno = EIO;
+		return (-1);
+	}
+	return (0);
+}
+
+static int batch_op(Libnorsim &libnorsim, int fd, struct norsim_op &op) {
+	void *buf = reinterpret_cast<void*>(static_cast<uintptr_t>(op.buf));
+	erase_info_t ei;
+	int ret;
+
+	errno = 0;
+	switch (op.type) {
+		case NORSIM_OP_READ:
+			ret = internal_pread(libnorsim, fd, buf, op.length, op.offset);
+			trace_op(libnorsim, TRACE_OP_PREAD, op.offset, op.length, ret, buf, (ret > 0)?(ret):(0));
+			break;
+		case NORSIM_OP_PROGRAM:
+			ret = internal_pwrite(libnorsim, fd, buf, op.length, op.offset);
+			trace_op(libnorsim, TRACE_OP_PWRITE, op.offset, op.length, ret, buf, op.length);
+			break;
+		case NORSIM_OP_UNLOCK:
+		case NORSIM_OP_ERASE:
+			ei.start = op.offset;
+			ei.length = op.length;
+			if ((ei.start != op.offset) || (ei.length != op.length)) {
+				libnorsim.getLogger().log(Loglevel::WARNING, "Batched operation exceeds erase_info_t range");
+				errno = EINVAL;
 				ret = -1;
-			if (E_BEH_EIO == libnorsim.getPageManager().getWeakPageBehavior()) {
-				libnorsim.getLogger().log(Loglevel::NOTE, "EIO error at page: %lu", false, index);
-				return (-1);
+				break;
+			}
+			if (NORSIM_OP_UNLOCK == op.type) {
+				ret = internal_ioctl_memunlock(libnorsim, &ei);
+				trace_op(libnorsim, TRACE_OP_UNLOCK, ei.start, ei.length, ret, NULL, 0);
 			} else {
-				libnorsim.getLogger().log(Loglevel::NOTE, "RND error at page: %lu", false, index);
+				ret = internal_ioctl_memerase(libnorsim, &ei);
+				if ((0 != ret) || (NULL == libnorsim.getEraseEngine()))
+					trace_op(libnorsim, TRACE_OP_ERASE, ei.start, ei.length, ret, NULL, 0);
 			}
-		} else {
-			if (libnorsim.getEraseSize() ==
-				libnorsim.getSyscallsCache().invokePwrite(libnorsim.getCacheFileFd(), libnorsim.getPageBuffer(), ei->length, ei->start)
-			)
-				return (0);
-			else
-				return (-1);
-		}
-	} else {
-		libnorsim.getLogger().log(Loglevel::WARNING, "Page %ld locked, rejecting erase request", false, index);
+			break;
+		default:
+			libnorsim.getLogger().log(Loglevel::WARNING, "Unknown batched operation: %u", false, op.type);
+			errno = EINVAL;
+			ret = -1;
+			break;
+	}
+	op.result = (ret >= 0)?(ret):(-((0 != errno)?(errno):(EIO)));
+	return (ret);
+}
+
+static int internal_ioctl_age(Libnorsim &libnorsim, va_list args) {
+	struct norsim_age *age = va_arg(args, struct norsim_age*);
+	NorDevice &device = libnorsim.getDevice();
+	libnorsim.getLogger().log(Loglevel::NOTE, "Got NORSIM_IOC_AGE request, start=0x%lX, length=0x%lX, erases=%lu, programs=%lu", false,
+		age->offset, age->length, age->erases, age->programs);
+
+	if (!device.isRangeValid(age->offset, age->length)) {
+		errno = EINVAL;
+		return (-1);
+	}
+	unsigned first = device.getBlock(age->offset);
+	unsigned count = device.getBlocksIn(age->offset, age->length);
+	for (unsigned index = first; index < first + count; ++index) {
+		if (!block_access(libnorsim, index))
+			return (-1);
+	}
+	BlockLock bl(libnorsim, first, count);
+	return (device.ageBlocks(first, count, age->erases, age->programs));
+}
+
+static int internal_ioctl_power_cut(Libnorsim &libnorsim, va_list args) {
+	struct norsim_power_cut *cut = va_arg(args, struct norsim_power_cut*);
+	libnorsim.getLogger().log(Loglevel::NOTE, "Got NORSIM_IOC_POWER_CUT request, first=%lu, last=%lu", false, cut->first, cut->last);
+
+	if (cut->first > cut->last) {
+		errno = EINVAL;
+		return (-1);
+	}
+	libnorsim.getDevice().armPowerCut(cut->first, cut->last);
+	return (0);
+}
+
+static int internal_ioctl_power_on(Libnorsim &libnorsim) {
+	libnorsim.getLogger().log(Loglevel::NOTE, "Got NORSIM_IOC_POWER_ON request");
+	libnorsim.getDevice().restorePower();
+	return (0);
+}
+
+// queued erases are finished first, so they belong to checkpoint they were requested before
+static int internal_ioctl_checkpoint(Libnorsim &libnorsim, va_list args) {
+	uint64_t *checkpoint = va_arg(args, uint64_t*);
+	libnorsim.getLogger().log(Loglevel::NOTE, "Got NORSIM_IOC_CHECKPOINT request");
+
+	if (libnorsim.getSharedDevice()) {
+		errno = EOPNOTSUPP;
+		return (-1);
+	}
+	if (NULL != libnorsim.getEraseEngine())
+		libnorsim.getEraseEngine()->drain();
+	*checkpoint = libnorsim.getDevice().checkpoint();
+	return (0);
+}
+
+static int internal_ioctl_rollback(Libnorsim &libnorsim, va_list args) {
+	uint64_t *checkpoint = va_arg(args, uint64_t*);
+	libnorsim.getLogger().log(Loglevel::NOTE, "Got NORSIM_IOC_ROLLBACK request, checkpoint=%lu", false, *checkpoint);
+
+	if (libnorsim.getSharedDevice()) {
+		errno = EOPNOTSUPP;
 		return (-1);
 	}
+	if (NULL != libnorsim.getEraseEngine())
+		libnorsim.getEraseEngine()->drain();
+	return (libnorsim.getDevice().rollback(*checkpoint));
+}
+
+// blocks are locked by caller when device is shared
+static int erase_blocks(Libnorsim &libnorsim, const unsigned first, const unsigned count) {
+	NorDevice &device = libnorsim.getDevice();
+	TimingModel *timing = libnorsim.getTimingModel();
+	uint64_t cost = 0;
+	int ret;
+
+	// cost depends on wear before erase, asynchronous erase has waited for it already
+	if (NULL != timing) {
+		for (unsigned index = first; index < first + count; ++index)
+			cost += timing->getEraseCost(device.getPage(index));
+	}
+
+	ret = device.eraseBlocks(first, count);
+	if ((0 == ret) && (NULL != timing))
+		timing->chargeErase(cost, NULL == libnorsim.getEraseEngine());
+
+	if (NULL != libnorsim.getSyncPolicy())
+		libnorsim.getSyncPolicy()->noteErase(device.getBlockOffset(first), device.getBlockOffset(first + count) - device.getBlockOffset(first));
+	return (ret);
+}
 
+// queued erase is traced when done, so faults are attached to it and replay keeps completion order
+static int erase_job(Libnorsim &libnorsim, const unsigned first, const unsigned count) {
+	int ret;
+	{
+		BlockLock bl(libnorsim, first, count);
+		ret = erase_blocks(libnorsim, first, count);
+	}
+	NorGeometry &geometry = libnorsim.getGeometry();
+	trace_op(libnorsim, TRACE_OP_ERASE, geometry.getBlockOffset(first), geometry.getBlockOffset(first + count) - geometry.getBlockOffset(first), ret, NULL, 0);
 	return (ret);
 }
 
 static int internal_ioctl(Libnorsim &libnorsim, int fd, unsigned long request, va_list args) {
-	(void)fd;
 	switch (request) {
 		case MEMGETINFO: return (internal_ioctl_memgetinfo(libnorsim, args));
-		case MEMUNLOCK: return (internal_ioctl_memunlock(libnorsim, args));
-		case MEMERASE: return (internal_ioctl_memerase(libnorsim, args));
+		case MEMUNLOCK: return (internal_ioctl_memunlock(libnorsim, va_arg(args, erase_info_t*)));
+		case MEMERASE: return (internal_ioctl_memerase(libnorsim, va_arg(args, erase_info_t*)));
+		case MEMGETREGIONCOUNT: return (internal_ioctl_memgetregioncount(libnorsim, args));
+		case MEMGETREGIONINFO: return (internal_ioctl_memgetregioninfo(libnorsim, args));
+		case NORSIM_IOC_GET_CLOCK: return (internal_ioctl_getclock(libnorsim, args));
+		case NORSIM_IOC_BATCH: return (internal_ioctl_batch(libnorsim, fd, args));
+		case NORSIM_IOC_AGE: return (internal_ioctl_age(libnorsim, args));
+		case NORSIM_IOC_POWER_CUT: return (internal_ioctl_power_cut(libnorsim, args));
+		case NORSIM_IOC_POWER_ON: return (internal_ioctl_power_on(libnorsim));
+		case NORSIM_IOC_CHECKPOINT: return (internal_ioctl_checkpoint(libnorsim, args));
+		case NORSIM_IOC_ROLLBACK: return (internal_ioctl_rollback(libnorsim, args));
 	}
 	return (-1);
 }
 
+// waits for (or rejects) access to block being erased asynchronously
+static bool block_access(Libnorsim &libnorsim, const unsigned index) {
+	EraseEngine *engine = libnorsim.getEraseEngine();
+	return ((NULL == engine) || engine->access(index));
+}
+
+static bool is_erase_info_valid(Libnorsim &libnorsim, const erase_info_t *ei) {
+	return (libnorsim.getDevice().isRangeValid(ei->start, ei->length));
+}
+
+static void trace_op(Libnorsim &libnorsim, const e_trace_op_t op, off_t offset, size_t length, int result, const void *data, size_t dataSize) {
+	TraceRecorder *trace = libnorsim.getTraceRecorder();
+	if (NULL != trace)
+		trace->record(op, offset, length, libnorsim.getGeometry().getBlock(offset), result, data, dataSize);
+}
+
+static void trace_ioctl(Libnorsim &libnorsim, unsigned long request, va_list args, int result) {
+	if (NULL == libnorsim.getTraceRecorder())
+		return;
+
+	erase_info_t *ei;
+	switch (request) {
+		case MEMGETINFO:
+			trace_op(libnorsim, TRACE_OP_GETINFO, 0, 0, result, NULL, 0);
+			break;
+		case MEMUNLOCK:
+		case MEMERASE:
+			// queued erase is traced by erase_job()
+			if ((MEMERASE == request) && (0 == result) && (NULL != libnorsim.getEraseEngine()))
+				break;
+			ei = va_arg(args, erase_info_t*);
+			trace_op(libnorsim, (MEMUNLOCK == request)?(TRACE_OP_UNLOCK):(TRACE_OP_ERASE), ei->start, ei->length, result, NULL, 0);
+			break;
+		case NORSIM_IOC_BATCH:
+			// operations are traced by batch_op()
+			break;
+		default:
+			libnorsim.getTraceRecorder()->record(TRACE_OP_IOCTL, request, 0, 0, result);
+			break;
+	}
+}
+
+static uint64_t latency_start(Libnorsim &libnorsim) {
+	return ((NULL != libnorsim.getLatencyStats())?(LatencyStats::now()):(0));
+}
+
+static void latency_op(Libnorsim &libnorsim, const e_lat_op_t op, uint64_t start) {
+	LatencyStats *stats = libnorsim.getLatencyStats();
+	if (NULL != stats)
+		stats->recordOp(op, start);
+}
+
+static void latency_phase(Libnorsim &libnorsim, const e_lat_phase_t phase, uint64_t start) {
+	LatencyStats *stats = libnorsim.getLatencyStats();
+	if (NULL != stats)
+		stats->recordPhase(phase, start);
+}
+
 } // extern "C"
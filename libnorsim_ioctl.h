@@ -0,0 +1,83 @@
+#ifndef __LIBNORSIM_IOCTL_H__
+#define __LIBNORSIM_IOCTL_H__
+
+// Requests understood by libnorsim on emulated device descriptor in addition
+// to MTD ones, usable from C and C++ programs (header has no other dependencies)
+
+#include <stdint.h>
+
+#include <sys/ioctl.h>
+
+#define NORSIM_IOC_MAGIC 'N'
+
+// virtual clock of timing model (NS_TIMING), all values in ns of device time;
+// fails with ENOTTY when timing model isn't enabled
+struct norsim_clock {
+	uint64_t now;
+	uint64_t read;
+	uint64_t program;
+	uint64_t erase;
+};
+
+// operations executed by single NORSIM_IOC_BATCH request
+#define NORSIM_OP_READ    0
+#define NORSIM_OP_PROGRAM 1
+#define NORSIM_OP_UNLOCK  2
+#define NORSIM_OP_ERASE   3
+
+// stop at first failed operation, following ones are left with result 0
+#define NORSIM_BATCH_STOP_ON_ERROR 0x01
+
+// offset and length are used like pread/pwrite arguments or erase_info_t,
+// buf (pointer) is used by read and program; result is set by libnorsim:
+// bytes transferred (read, program), 0 (unlock, erase) or -errno
+struct norsim_op {
+	uint32_t type;
+	int32_t result;
+	uint64_t offset;
+	uint64_t length;
+	uint64_t buf;
+};
+
+// ops points to count operations executed in order with device locked once,
+// writes to cache file are gathered until batch ends; done is number of
+// executed operations and failed number of those which failed
+struct norsim_batch {
+	uint64_t ops;
+	uint32_t count;
+	uint32_t flags;
+	uint32_t done;
+	uint32_t failed;
+};
+
+// cycles added at once to eraseblocks of range (offset and length like
+// erase_info_t), see NS_AGE
+struct norsim_age {
+	uint64_t offset;
+	uint64_t length;
+	uint64_t erases;
+	uint64_t programs;
+};
+
+// power cut armed to program or erase drawn from [first, last], counted from
+// request (1 - next one, 0 - cut right away), see NS_POWER_FAIL
+struct norsim_power_cut {
+	uint64_t first;
+	uint64_t last;
+};
+
+#define NORSIM_IOC_GET_CLOCK _IOR(NORSIM_IOC_MAGIC, 0x01, struct norsim_clock)
+// returns 0 when all operations succeeded, -1 with errno EIO when some failed,
+// EINVAL when batch itself is invalid (nothing executed)
+#define NORSIM_IOC_BATCH     _IOWR(NORSIM_IOC_MAGIC, 0x02, struct norsim_batch)
+#define NORSIM_IOC_AGE       _IOW(NORSIM_IOC_MAGIC, 0x03, struct norsim_age)
+// all operations fail with EIO after power cut until power is restored (by
+// NORSIM_IOC_POWER_ON or reopening device), which locks all eraseblocks
+#define NORSIM_IOC_POWER_CUT _IOW(NORSIM_IOC_MAGIC, 0x04, struct norsim_power_cut)
+#define NORSIM_IOC_POWER_ON  _IO(NORSIM_IOC_MAGIC, 0x05)
+// checkpoint is returned in argument and passed to rollback, which restores
+// contents and page states of it; EOPNOTSUPP when device is shared
+#define NORSIM_IOC_CHECKPOINT _IOR(NORSIM_IOC_MAGIC, 0x06, uint64_t)
+#define NORSIM_IOC_ROLLBACK   _IOW(NORSIM_IOC_MAGIC, 0x07, uint64_t)
+
+#endif // __LIBNORSIM_IOCTL_H__
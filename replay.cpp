@@ -0,0 +1,297 @@
+// Replays binary trace recorded by libnorsim (NS_TRACE) against flash device,
+// to replay against simulator run it with libnorsim preloaded and NS_* variables
+// describing the same device (NS_SEED makes "rnd" faults repeatable)
+
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#include <mtd/mtd-user.h>
+
+#include "TraceFormat.h"
+
+struct st_replay_opts_t {
+	unsigned threads;
+	bool timed;
+	double speed;
+	bool verify;
+	bool dump;
+	const char *trace;
+	const char *device;
+};
+
+struct st_replay_stats_t {
+	unsigned long ops;
+	unsigned long skipped;
+	unsigned long result_mismatches;
+	unsigned long data_mismatches;
+	unsigned long fault_mismatches;
+};
+
+static const char* get_op_name(const uint8_t op)
+{
+	switch (op) {
+		case TRACE_OP_OPEN: return ("open");
+		case TRACE_OP_CLOSE: return ("close");
+		case TRACE_OP_PREAD: return ("pread");
+		case TRACE_OP_PWRITE: return ("pwrite");
+		case TRACE_OP_GETINFO: return ("getinfo");
+		case TRACE_OP_UNLOCK: return ("unlock");
+		case TRACE_OP_ERASE: return ("erase");
+		case TRACE_OP_IOCTL: return ("ioctl");
+		default: return ("?");
+	}
+}
+
+static const char* get_fault_name(const uint8_t fault)
+{
+	switch (fault) {
+		case TRACE_FAULT_EIO: return ("eio");
+		case TRACE_FAULT_RND: return ("rnd");
+		case TRACE_FAULT_POWER: return ("power");
+		default: return ("-");
+	}
+}
+
+static void print_usage(const char *name)
+{
+	printf("usage: %s [options] <trace_file> [<device>]\n", name);
+	puts("options:");
+	puts("\t-t <threads>\treplay using given number of threads, operations are distributed by block");
+	puts("\t\t\t(order is kept within each block only)");
+	puts("\t-r\t\treplay with original timing");
+	puts("\t-x <factor>\tspeed up original timing by given factor (implies -r)");
+	puts("\t-v\t\tverify results and data hashes against recording");
+	puts("\t-d\t\tdump trace records instead of replaying");
+}
+
+// collects records in order they were recorded (handles ring traces)
+static bool load_trace(const char *path, const st_trace_header_t **header, std::vector<const st_trace_record_t*> &records)
+{
+	int fd = open(path, O_RDONLY);
+	if (fd < 0) {
+		printf("couldn't open trace: %s\n", path);
+		return (false);
+	}
+	struct stat st;
+	if ((fstat(fd, &st) < 0) || (static_cast<size_t>(st.st_size) < sizeof(st_trace_header_t))) {
+		printf("trace too short: %s\n", path);
+		close(fd);
+		return (false);
+	}
+	void *map = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+	close(fd);
+	if (MAP_FAILED == map) {
+		printf("couldn't map trace: %s\n", path);
+		return (false);
+	}
+
+	const st_trace_header_t *hdr = static_cast<const st_trace_header_t*>(map);
+	const char *data = reinterpret_cast<const char*>(&hdr[1]);
+	if ((0 != memcmp(hdr->magic, TRACE_MAGIC, sizeof(hdr->magic))) || (TRACE_VERSION != hdr->version) ||
+		(sizeof(st_trace_header_t) + hdr->data_size > static_cast<uint64_t>(st.st_size))) {
+		printf("invalid trace: %s\n", path);
+		return (false);
+	}
+
+	uint64_t pos = hdr->first;
+	records.reserve(hdr->live);
+	for (uint64_t i = 0; i < hdr->live; ++i) {
+		if ((hdr->data_size - pos < sizeof(st_trace_record_t)) ||
+			(TRACE_OP_WRAP == reinterpret_cast<const st_trace_record_t*>(&data[pos])->op))
+			pos = 0;
+		const st_trace_record_t *rec = reinterpret_cast<const st_trace_record_t*>(&data[pos]);
+		pos += sizeof(st_trace_record_t) + TRACE_ALIGN(rec->payload);
+		if (pos > hdr->data_size) {
+			printf("trace corrupted at record %lu\n", i);
+			return (false);
+		}
+		records.push_back(rec);
+	}
+	*header = hdr;
+	return (true);
+}
+
+static void dump_trace(const st_trace_header_t *header, const std::vector<const st_trace_record_t*> &records)
+{
+	printf("size=%lu erase_size=%u flags=0x%X records=%lu (available=%lu)\n",
+		header->size, header->erase_size, header->flags, header->records, header->live);
+	for (const st_trace_record_t *rec : records) {
+		printf("%12.6f %-8s offset=0x%08lX length=0x%06X block=%-6u result=%-8d fault=%s hash=%016lX%s\n",
+			rec->timestamp / 1e9, get_op_name(rec->op), rec->offset, rec->length, rec->block,
+			rec->result, get_fault_name(rec->fault), rec->hash, (rec->payload)?(" +payload"):(""));
+	}
+}
+
+static void replay_record(const st_replay_opts_t &opts, const st_trace_header_t *header, int fd,
+	const st_trace_record_t *rec, std::vector<char> &buf, st_replay_stats_t &stats, std::chrono::steady_clock::time_point start)
+{
+	mtd_info_t mtd_info;
+	erase_info_t ei;
+	int res;
+
+	if (opts.timed)
+		std::this_thread::sleep_until(start + std::chrono::nanoseconds(static_cast<uint64_t>(rec->timestamp / opts.speed)));
+	if ((rec->length > buf.size()) && ((TRACE_OP_PREAD == rec->op) || (TRACE_OP_PWRITE == rec->op)))
+		buf.resize(rec->length);
+
+	switch (rec->op) {
+		case TRACE_OP_PREAD:
+			res = pread(fd, buf.data(), rec->length, rec->offset);
+			break;
+		case TRACE_OP_PWRITE:
+			// without payload 0xFF is written which leaves NOR contents intact
+			if (rec->payload)
+				memcpy(buf.data(), &rec[1], rec->length);
+			else
+				memset(buf.data(), 0xFF, rec->length);
+			res = pwrite(fd, buf.data(), rec->length, rec->offset);
+			break;
+		case TRACE_OP_GETINFO:
+			res = ioctl(fd, MEMGETINFO, &mtd_info);
+			break;
+		case TRACE_OP_UNLOCK:
+		case TRACE_OP_ERASE:
+			ei.start = rec->offset;
+			ei.length = rec->length;
+			res = ioctl(fd, (TRACE_OP_UNLOCK == rec->op)?(MEMUNLOCK):(MEMERASE), &ei);
+			break;
+		default:
+			stats.skipped++;
+			return;
+	}
+	stats.ops++;
+	if (!opts.verify)
+		return;
+
+	bool mismatch = false;
+	if (res != rec->result) {
+		stats.result_mismatches++;
+		mismatch = true;
+	} else if ((TRACE_OP_PREAD == rec->op) && (header->flags & TRACE_FLAG_HASH) && (res > 0) &&
+		(trace_hash(buf.data(), res) != rec->hash)) {
+		stats.data_mismatches++;
+		mismatch = true;
+	}
+	if (mismatch && (TRACE_FAULT_NONE != rec->fault))
+		stats.fault_mismatches++;
+	if (mismatch) {
+		printf("mismatch: %s offset=0x%lX length=0x%X: result=%d (recorded: %d, fault: %s)\n",
+			get_op_name(rec->op), rec->offset, rec->length, res, rec->result, get_fault_name(rec->fault));
+	}
+}
+
+// operations spanning more than one block can't be assigned to single worker
+static bool is_barrier(const st_trace_header_t *header, const st_trace_record_t *rec)
+{
+	if (0 == rec->length)
+		return (false);
+	return ((rec->offset / header->erase_size) != ((rec->offset + rec->length - 1) / header->erase_size));
+}
+
+static void replay_worker(const st_replay_opts_t &opts, const st_trace_header_t *header, int fd,
+	const st_trace_record_t* const *first, const st_trace_record_t* const *last, unsigned id,
+	st_replay_stats_t &stats, std::chrono::steady_clock::time_point start)
+{
+	std::vector<char> buf(header->erase_size);
+
+	for (; first != last; ++first) {
+		if (((*first)->block % opts.threads) == id)
+			replay_record(opts, header, fd, *first, buf, stats, start);
+	}
+}
+
+int main(int argc, char *argv[])
+{
+	st_replay_opts_t opts = {1, false, 1.0, false, false, NULL, NULL};
+	int opt;
+
+	while (-1 != (opt = getopt(argc, argv, "t:rx:vdh"))) {
+		switch (opt) {
+			case 't': opts.threads = strtoul(optarg, NULL, 10); break;
+			case 'r': opts.timed = true; break;
+			case 'x': opts.timed = true; opts.speed = strtod(optarg, NULL); break;
+			case 'v': opts.verify = true; break;
+			case 'd': opts.dump = true; break;
+			default: print_usage(argv[0]); return (1);
+		}
+	}
+	if ((optind >= argc) || (0 == opts.threads) || (opts.speed <= 0.0) || (!opts.dump && (optind + 2 != argc))) {
+		print_usage(argv[0]);
+		return (1);
+	}
+	opts.trace = argv[optind];
+	opts.device = argv[optind + 1];
+
+	const st_trace_header_t *header;
+	std::vector<const st_trace_record_t*> records;
+	if (!load_trace(opts.trace, &header, records))
+		return (1);
+	if (opts.dump) {
+		dump_trace(header, records);
+		return (0);
+	}
+
+	int fd = open(opts.device, O_RDWR);
+	if (fd < 0) {
+		printf("couldn't open device: %s\n", opts.device);
+		return (1);
+	}
+
+	// records between barriers are replayed in parallel, barriers by main thread
+	std::vector<st_replay_stats_t> stats(opts.threads + 1);
+	std::vector<char> buf(header->erase_size);
+	memset(stats.data(), 0x00, stats.size() * sizeof(st_replay_stats_t));
+	auto start = std::chrono::steady_clock::now();
+	size_t first = 0;
+	for (size_t i = 0; i <= records.size(); ++i) {
+		if ((i < records.size()) && !is_barrier(header, records[i]))
+			continue;
+		if (1 == opts.threads) {
+			replay_worker(opts, header, fd, &records[first], &records[i], 0, stats[0], start);
+		} else if (first != i) {
+			std::vector<std::thread> workers;
+			for (unsigned id = 0; id < opts.threads; ++id)
+				workers.emplace_back(replay_worker, std::cref(opts), header, fd, &records[first], &records[i], id, std::ref(stats[id]), start);
+			for (std::thread &worker : workers)
+				worker.join();
+		}
+		if (i < records.size())
+			replay_record(opts, header, fd, records[i], buf, stats[opts.threads], start);
+		first = i + 1;
+	}
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	close(fd);
+
+	st_replay_stats_t total;
+	memset(&total, 0x00, sizeof(total));
+	for (const st_replay_stats_t &s : stats) {
+		total.ops += s.ops;
+		total.skipped += s.skipped;
+		total.result_mismatches += s.result_mismatches;
+		total.data_mismatches += s.data_mismatches;
+		total.fault_mismatches += s.fault_mismatches;
+	}
+	double recorded = (records.empty())?(0.0):(records.back()->timestamp / 1e9);
+
+	printf("replayed:  %lu operations (%lu skipped) in %.3fs, %.0f ops/s\n",
+		total.ops, total.skipped, elapsed, (elapsed > 0.0)?(total.ops / elapsed):(0.0));
+	printf("recorded:  %.3fs, speedup: %.1fx\n", recorded, (elapsed > 0.0)?(recorded / elapsed):(0.0));
+	if (opts.verify) {
+		printf("verified:  %lu result mismatches, %lu data mismatches (%lu at injected faults)\n",
+			total.result_mismatches, total.data_mismatches, total.fault_mismatches);
+		return ((total.result_mismatches || total.data_mismatches)?(2):(0));
+	}
+	return (0);
+}
@@ -0,0 +1,461 @@
+// Flash workload generator working on MTD interface, to measure simulator run it
+// with libnorsim preloaded (works with real MTD character devices as well)
+
+#include <algorithm>
+#include <atomic>
+#include <cerrno>
+#include <chrono>
+#include <cmath>
+#include <csignal>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <memory>
+#include <random>
+#include <string>
+#include <thread>
+#include <vector>
+
+#include <fcntl.h>
+#include <getopt.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+
+#include <mtd/mtd-user.h>
+
+#include "Histogram.h"
+#include "libnorsim_ioctl.h"
+
+#define WORKLOAD_DURATION   10
+#define WORKLOAD_CHUNK_SIZE 512
+#define WORKLOAD_READ_PCT   25
+#define WORKLOAD_SKEW       0.99
+
+enum e_pattern_t {
+	E_PATTERN_APPEND = 0,
+	E_PATTERN_RANDOM,
+	E_PATTERN_META,
+	E_PATTERN_SWEEP,
+	E_PATTERN_COUNT
+};
+
+enum e_stat_op_t {
+	E_STAT_READ = 0,
+	E_STAT_WRITE,
+	E_STAT_ERASE,
+	E_STAT_COUNT
+};
+
+enum e_chunk_state_t {
+	E_CHUNK_UNKNOWN = 0,
+	E_CHUNK_ERASED,
+	E_CHUNK_WRITTEN
+};
+
+static const char * const pattern_names[E_PATTERN_COUNT] = {"append", "random", "meta", "sweep"};
+static const char * const stat_names[E_STAT_COUNT] = {"read", "write", "erase"};
+
+struct st_workload_opts_t {
+	unsigned threads;
+	unsigned duration;
+	unsigned chunkSize;
+	unsigned readPct;
+	double skew;
+	unsigned seed;
+	bool report;
+	std::vector<e_pattern_t> mix;
+	const char *device;
+	const char *output;
+};
+
+struct st_workload_stats_t {
+	Histogram latency[E_STAT_COUNT];
+	unsigned long bytes[E_STAT_COUNT];
+	unsigned long errors[E_STAT_COUNT];
+	unsigned long corrupted;
+};
+
+static std::atomic<bool> stop_requested(false);
+
+class Worker {
+public:
+	Worker(const st_workload_opts_t &opts, int fd, e_pattern_t pattern, unsigned firstBlock, unsigned blockCount,
+		unsigned eraseSize, unsigned seed);
+
+	void run();
+
+	const st_workload_stats_t& getStats() { return (m_stats); }
+	e_pattern_t getPattern() { return (m_pattern); }
+
+private:
+	void stepAppend();
+	void stepRandom();
+	void stepMeta();
+	void stepSweep();
+
+	void doRead(const unsigned block, const unsigned chunk);
+	void doWrite(const unsigned block, const unsigned chunk);
+	void doErase(const unsigned block);
+
+	bool isRead() { return (m_pct(m_rng) < m_opts.readPct); }
+	unsigned pickBlock() { return (std::upper_bound(m_zipf.begin(), m_zipf.end(), m_uniform(m_rng)) - m_zipf.begin()); }
+	char getPatternByte(const unsigned block, const unsigned chunk) { return ((m_firstBlock + block) * 131 + chunk * 7 + 1); }
+	e_chunk_state_t& getChunk(const unsigned block, const unsigned chunk) { return (m_chunks[block * m_chunksPerBlock + chunk]); }
+
+	const st_workload_opts_t &m_opts;
+	int m_fd;
+	e_pattern_t m_pattern;
+	unsigned m_firstBlock;
+	unsigned m_blockCount;
+	unsigned m_eraseSize;
+	unsigned m_chunksPerBlock;
+
+	// append and sweep position, per block write pointers for metadata churn
+	unsigned m_curBlock;
+	unsigned m_curChunk;
+	std::vector<unsigned> m_writePointers;
+	std::vector<e_chunk_state_t> m_chunks;
+	std::vector<char> m_buf;
+
+	std::mt19937_64 m_rng;
+	std::uniform_real_distribution<double> m_uniform;
+	std::uniform_int_distribution<unsigned> m_pct;
+	std::vector<double> m_zipf;
+
+	st_workload_stats_t m_stats;
+};
+
+Worker::Worker(const st_workload_opts_t &opts, int fd, e_pattern_t pattern, unsigned firstBlock, unsigned blockCount,
+	unsigned eraseSize, unsigned seed)
+ : m_opts(opts), m_fd(fd), m_pattern(pattern), m_firstBlock(firstBlock), m_blockCount(blockCount),
+   m_eraseSize(eraseSize), m_chunksPerBlock(eraseSize / opts.chunkSize), m_curBlock(0), m_curChunk(0),
+   m_writePointers(blockCount, 0), m_chunks(blockCount * m_chunksPerBlock, E_CHUNK_UNKNOWN), m_buf(opts.chunkSize),
+   m_rng(seed), m_uniform(0.0, 1.0), m_pct(0, 99), m_zipf(blockCount) {
+	// cumulative distribution of block popularity, skew 0.0 is uniform
+	double sum = 0.0;
+	for (unsigned i = 0; i < m_blockCount; ++i) {
+		sum += 1.0 / pow(i + 1, opts.skew);
+		m_zipf[i] = sum;
+	}
+	for (double &p : m_zipf)
+		p /= sum;
+	m_zipf.back() = 1.0;
+	memset(&m_stats.bytes, 0x00, sizeof(m_stats.bytes));
+	memset(&m_stats.errors, 0x00, sizeof(m_stats.errors));
+	m_stats.corrupted = 0;
+}
+
+void Worker::run() {
+	while (!stop_requested.load(std::memory_order_relaxed)) {
+		switch (m_pattern) {
+			case E_PATTERN_APPEND: stepAppend(); break;
+			case E_PATTERN_RANDOM: stepRandom(); break;
+			case E_PATTERN_META: stepMeta(); break;
+			case E_PATTERN_SWEEP: stepSweep(); break;
+			default: return;
+		}
+	}
+}
+
+// log-structured append over whole region, reads are spread uniformly
+void Worker::stepAppend() {
+	if (isRead()) {
+		doRead(m_rng() % m_blockCount, m_rng() % m_chunksPerBlock);
+		return;
+	}
+	if (0 == m_curChunk)
+		doErase(m_curBlock);
+	doWrite(m_curBlock, m_curChunk);
+	if (++m_curChunk == m_chunksPerBlock) {
+		m_curChunk = 0;
+		m_curBlock = (m_curBlock + 1) % m_blockCount;
+	}
+}
+
+// small writes to random erased chunks of skewed blocks, block is erased when full
+void Worker::stepRandom() {
+	unsigned block = pickBlock();
+	unsigned chunk = m_rng() % m_chunksPerBlock;
+	if (isRead()) {
+		doRead(block, chunk);
+		return;
+	}
+	for (unsigned i = 0; i < m_chunksPerBlock; ++i) {
+		if (E_CHUNK_ERASED == getChunk(block, chunk)) {
+			doWrite(block, chunk);
+			return;
+		}
+		chunk = (chunk + 1) % m_chunksPerBlock;
+	}
+	doErase(block);
+	doWrite(block, chunk);
+}
+
+// hot/cold metadata records appended within skewed blocks, latest record is read back
+void Worker::stepMeta() {
+	unsigned block = pickBlock();
+	unsigned &wp = m_writePointers[block];
+	if (isRead()) {
+		doRead(block, (wp)?(wp - 1):(0));
+		return;
+	}
+	if ((0 == wp) || (wp == m_chunksPerBlock)) {
+		doErase(block);
+		wp = 0;
+	}
+	doWrite(block, wp++);
+}
+
+// wear-leveling sweep: erase, fill and verify every block of region in turn
+void Worker::stepSweep() {
+	if (0 == m_curChunk)
+		doErase(m_curBlock);
+	doWrite(m_curBlock, m_curChunk);
+	doRead(m_curBlock, m_curChunk);
+	if (++m_curChunk == m_chunksPerBlock) {
+		m_curChunk = 0;
+		m_curBlock = (m_curBlock + 1) % m_blockCount;
+	}
+}
+
+void Worker::doRead(const unsigned block, const unsigned chunk) {
+	off_t offset = static_cast<off_t>(m_firstBlock + block) * m_eraseSize + chunk * m_opts.chunkSize;
+
+	auto start = std::chrono::steady_clock::now();
+	ssize_t res = pread(m_fd, m_buf.data(), m_opts.chunkSize, offset);
+	m_stats.latency[E_STAT_READ].record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+	if (res != static_cast<ssize_t>(m_opts.chunkSize)) {
+		m_stats.errors[E_STAT_READ]++;
+		return;
+	}
+	m_stats.bytes[E_STAT_READ] += res;
+
+	e_chunk_state_t state = getChunk(block, chunk);
+	if (E_CHUNK_UNKNOWN == state)
+		return;
+	char expected = (E_CHUNK_WRITTEN == state)?(getPatternByte(block, chunk)):(static_cast<char>(0xFF));
+	for (char c : m_buf) {
+		if (c != expected) {
+			m_stats.corrupted++;
+			break;
+		}
+	}
+}
+
+void Worker::doWrite(const unsigned block, const unsigned chunk) {
+	off_t offset = static_cast<off_t>(m_firstBlock + block) * m_eraseSize + chunk * m_opts.chunkSize;
+
+	memset(m_buf.data(), getPatternByte(block, chunk), m_opts.chunkSize);
+	auto start = std::chrono::steady_clock::now();
+	ssize_t res = pwrite(m_fd, m_buf.data(), m_opts.chunkSize, offset);
+	m_stats.latency[E_STAT_WRITE].record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+	if (res != static_cast<ssize_t>(m_opts.chunkSize)) {
+		m_stats.errors[E_STAT_WRITE]++;
+		getChunk(block, chunk) = E_CHUNK_UNKNOWN;
+		return;
+	}
+	m_stats.bytes[E_STAT_WRITE] += res;
+	getChunk(block, chunk) = (E_CHUNK_ERASED == getChunk(block, chunk))?(E_CHUNK_WRITTEN):(E_CHUNK_UNKNOWN);
+}
+
+// unlock is part of erase, simulator locks block again after erasing it
+void Worker::doErase(const unsigned block) {
+	erase_info_t ei;
+	ei.start = (m_firstBlock + block) * m_eraseSize;
+	ei.length = m_eraseSize;
+
+	auto start = std::chrono::steady_clock::now();
+	ioctl(m_fd, MEMUNLOCK, &ei);
+	int res = ioctl(m_fd, MEMERASE, &ei);
+	m_stats.latency[E_STAT_ERASE].record(std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start).count());
+	e_chunk_state_t state = E_CHUNK_ERASED;
+	if (res < 0) {
+		m_stats.errors[E_STAT_ERASE]++;
+		state = E_CHUNK_UNKNOWN;
+	} else {
+		m_stats.bytes[E_STAT_ERASE] += m_eraseSize;
+	}
+	for (unsigned i = 0; i < m_chunksPerBlock; ++i)
+		getChunk(block, i) = state;
+}
+
+static void print_usage(const char *name)
+{
+	printf("usage: %s [options] <device>\n", name);
+	puts("options:");
+	puts("\t-t <threads>\tnumber of threads, each one works on its own part of device (default: 1)");
+	puts("\t-w <mix>\tcomma separated patterns assigned to threads in turn (default: append)");
+	puts("\t\t\tappend: log-structured append");
+	puts("\t\t\trandom: small writes to random erased space");
+	puts("\t\t\tmeta:   hot/cold metadata churn");
+	puts("\t\t\tsweep:  full erase/write/verify wear-leveling sweep");
+	puts("\t-r <pct>\tpercentage of reads for append, random and meta (default: 25)");
+	puts("\t-z <skew>\tZipf skew of block selection for random and meta, 0 is uniform (default: 0.99)");
+	puts("\t-s <bytes>\tsize of single read/write (default: 512)");
+	puts("\t-d <seconds>\tduration (default: 10)");
+	puts("\t-S <seed>\trandom seed");
+	puts("\t-R\t\trequest simulator report (SIGUSR1) after run");
+	puts("\t-o <file>\twrite results in tab separated format to given file");
+}
+
+static bool parse_mix(const char *str, std::vector<e_pattern_t> &mix)
+{
+	std::string s(str);
+	size_t pos = 0;
+	while (pos <= s.size()) {
+		size_t end = s.find(',', pos);
+		if (std::string::npos == end)
+			end = s.size();
+		std::string name = s.substr(pos, end - pos);
+		unsigned i;
+		for (i = 0; i < E_PATTERN_COUNT; ++i) {
+			if (name == pattern_names[i])
+				break;
+		}
+		if (E_PATTERN_COUNT == i) {
+			printf("unknown pattern: %s\n", name.c_str());
+			return (false);
+		}
+		mix.push_back(static_cast<e_pattern_t>(i));
+		pos = end + 1;
+	}
+	return (true);
+}
+
+// report is handled by libnorsim on next intercepted syscall, default action would kill us
+static void request_simulator_report(int fd)
+{
+	struct sigaction sa;
+	mtd_info_t mtd_info;
+
+	if ((0 != sigaction(SIGUSR1, NULL, &sa)) || (SIG_DFL == sa.sa_handler) || (SIG_IGN == sa.sa_handler)) {
+		puts("simulator not present, report not available");
+		return;
+	}
+	fflush(stdout);
+	raise(SIGUSR1);
+	ioctl(fd, MEMGETINFO, &mtd_info);
+}
+
+int main(int argc, char *argv[])
+{
+	st_workload_opts_t opts = {1, WORKLOAD_DURATION, WORKLOAD_CHUNK_SIZE, WORKLOAD_READ_PCT, WORKLOAD_SKEW,
+		static_cast<unsigned>(time(NULL)), false, {}, NULL, NULL};
+	int opt;
+
+	while (-1 != (opt = getopt(argc, argv, "t:w:r:z:s:d:S:Ro:h"))) {
+		switch (opt) {
+			case 't': opts.threads = strtoul(optarg, NULL, 10); break;
+			case 'w': if (!parse_mix(optarg, opts.mix)) return (1); break;
+			case 'r': opts.readPct = strtoul(optarg, NULL, 10); break;
+			case 'z': opts.skew = strtod(optarg, NULL); break;
+			case 's': opts.chunkSize = strtoul(optarg, NULL, 10); break;
+			case 'd': opts.duration = strtoul(optarg, NULL, 10); break;
+			case 'S': opts.seed = strtoul(optarg, NULL, 10); break;
+			case 'R': opts.report = true; break;
+			case 'o': opts.output = optarg; break;
+			default: print_usage(argv[0]); return (1);
+		}
+	}
+	if ((optind + 1 != argc) || (0 == opts.threads) || (0 == opts.chunkSize) || (opts.readPct > 100) || (opts.skew < 0.0)) {
+		print_usage(argv[0]);
+		return (1);
+	}
+	opts.device = argv[optind];
+	if (opts.mix.empty())
+		opts.mix.push_back(E_PATTERN_APPEND);
+
+	int fd = open(opts.device, O_RDWR);
+	if (fd < 0) {
+		printf("couldn't open device: %s\n", opts.device);
+		return (1);
+	}
+	mtd_info_t mtd_info;
+	if (ioctl(fd, MEMGETINFO, &mtd_info) < 0) {
+		printf("not an MTD device: %s\n", opts.device);
+		return (1);
+	}
+	unsigned block_count = mtd_info.size / mtd_info.erasesize;
+	if ((opts.chunkSize > mtd_info.erasesize) || (0 != mtd_info.erasesize % opts.chunkSize) || (block_count < opts.threads)) {
+		printf("invalid geometry: size=%u erasesize=%u, chunk=%u, threads=%u\n",
+			mtd_info.size, mtd_info.erasesize, opts.chunkSize, opts.threads);
+		return (1);
+	}
+
+	std::vector<std::unique_ptr<Worker>> workers;
+	unsigned region = block_count / opts.threads;
+	for (unsigned i = 0; i < opts.threads; ++i) {
+		workers.emplace_back(new Worker(opts, fd, opts.mix[i % opts.mix.size()], i * region, region,
+			mtd_info.erasesize, opts.seed + i));
+	}
+
+	printf("device: %s, size=%u, erasesize=%u, threads=%u, chunk=%u, reads=%u%%, skew=%.2f, seed=%u\n",
+		opts.device, mtd_info.size, mtd_info.erasesize, opts.threads, opts.chunkSize, opts.readPct, opts.skew, opts.seed);
+	fflush(stdout);
+
+	std::vector<std::thread> threads;
+	auto start = std::chrono::steady_clock::now();
+	for (std::unique_ptr<Worker> &worker : workers)
+		threads.emplace_back(&Worker::run, worker.get());
+	std::this_thread::sleep_for(std::chrono::seconds(opts.duration));
+	stop_requested = true;
+	for (std::thread &thread : threads)
+		thread.join();
+	double elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+	FILE *output = NULL;
+	if (opts.output) {
+		if (NULL == (output = fopen(opts.output, "w"))) {
+			printf("couldn't open output file: %s\n", opts.output);
+			return (1);
+		}
+		fputs("# pattern\top\tops\tops_per_sec\tMB_per_sec\terrors\tp50_ns\tp99_ns\tp999_ns\tmax_ns\n", output);
+	}
+
+	printf("%-8s %-6s %12s %12s %10s %8s %10s %10s %10s %12s\n", "pattern", "op", "ops", "ops/s", "MB/s",
+		"errors", "p50[ns]", "p99[ns]", "p99.9[ns]", "max[ns]");
+	unsigned long corrupted = 0;
+	for (unsigned p = 0; p < E_PATTERN_COUNT; ++p) {
+		st_workload_stats_t stats;
+		bool used = false;
+		memset(&stats.bytes, 0x00, sizeof(stats.bytes));
+		memset(&stats.errors, 0x00, sizeof(stats.errors));
+		for (std::unique_ptr<Worker> &worker : workers) {
+			if (worker->getPattern() != p)
+				continue;
+			used = true;
+			for (unsigned op = 0; op < E_STAT_COUNT; ++op) {
+				stats.latency[op].merge(worker->getStats().latency[op]);
+				stats.bytes[op] += worker->getStats().bytes[op];
+				stats.errors[op] += worker->getStats().errors[op];
+			}
+			corrupted += worker->getStats().corrupted;
+		}
+		if (!used)
+			continue;
+		for (unsigned op = 0; op < E_STAT_COUNT; ++op) {
+			const Histogram &h = stats.latency[op];
+			printf("%-8s %-6s %12lu %12.0f %10.2f %8lu %10lu %10lu %10lu %12lu\n", pattern_names[p], stat_names[op],
+				h.getCount(), h.getCount() / elapsed, stats.bytes[op] / elapsed / 1e6, stats.errors[op],
+				h.getPercentile(50.0), h.getPercentile(99.0), h.getPercentile(99.9), h.getMax());
+			if (output) {
+				fprintf(output, "%s\t%s\t%lu\t%.0f\t%.2f\t%lu\t%lu\t%lu\t%lu\t%lu\n", pattern_names[p], stat_names[op],
+					h.getCount(), h.getCount() / elapsed, stats.bytes[op] / elapsed / 1e6, stats.errors[op],
+					h.getPercentile(50.0), h.getPercentile(99.0), h.getPercentile(99.9), h.getMax());
+			}
+		}
+	}
+	printf("elapsed: %.3fs, corrupted reads: %lu\n", elapsed, corrupted);
+	struct norsim_clock clock;
+	if (0 == ioctl(fd, NORSIM_IOC_GET_CLOCK, &clock)) {
+		printf("device time: %.3fs (read: %.3fs, program: %.3fs, erase: %.3fs)\n", clock.now / 1e9,
+			clock.read / 1e9, clock.program / 1e9, clock.erase / 1e9);
+	}
+
+	if (output)
+		fclose(output);
+	if (opts.report)
+		request_simulator_report(fd);
+	close(fd);
+	return (0);
+}